@@ -0,0 +1,392 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AUDIO_ENGINE_H__
+#define __AUDIO_ENGINE_H__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <alsa/asoundlib.h>
+
+
+
+/*
+ * Plays short clips with low latency. Clips are decoded once into mono
+ * 16 bit PCM, and a mixer thread keeps the output fed with one period at
+ * a time, adding every clip being played. A trigger is heard within a
+ * period plus the output buffer.
+ */
+namespace audio
+{
+  typedef std::chrono::steady_clock Clock;
+
+  typedef std::vector<int16_t> Clip;
+
+
+
+  // Runs command, which must write raw mono signed 16 bit PCM at the
+  // engine rate to its standard output
+  inline Clip
+  decode (std::string const& command)
+  {
+    FILE* pipe = popen (command.c_str(), "r");
+    if (! pipe) {
+      throw std::runtime_error ("Cannot run \"" + command + "\"");
+    }
+
+    Clip clip;
+    int16_t buffer[4096];
+    size_t got;
+    while ( (got = fread (buffer, sizeof (int16_t), 4096, pipe)) > 0) {
+      clip.insert (clip.end(), buffer, buffer + got);
+    }
+
+    if ( (pclose (pipe) != 0) || clip.empty()) {
+      throw std::runtime_error ("Decoding failed: \"" + command + "\"");
+    }
+    return clip;
+  }
+
+
+
+  class Sink
+  {
+    public:
+      virtual
+      ~Sink() {}
+
+      // Blocks until the output takes all frames
+      virtual void
+      write (const int16_t* frames,
+             size_t count) = 0;
+
+      // Frames written and not yet played
+      virtual size_t
+      delay() = 0;
+  };
+
+
+
+  // ALSA playback, the default device goes through PulseAudio when it runs
+  class AlsaSink
+    : public Sink
+  {
+      snd_pcm_t* pcm_;
+
+      static void
+      check (int err,
+             std::string const& what)
+      {
+        if (err < 0) {
+          throw std::runtime_error (what + ": " + snd_strerror (err));
+        }
+      }
+
+    public:
+      AlsaSink (std::string const& device,
+                unsigned rate,
+                unsigned latency_us)
+        : pcm_ (nullptr)
+      {
+        check (snd_pcm_open (&pcm_, device.c_str(), SND_PCM_STREAM_PLAYBACK, 0), "Cannot open " + device);
+        int err = snd_pcm_set_params (pcm_, SND_PCM_FORMAT_S16, SND_PCM_ACCESS_RW_INTERLEAVED, 1, rate, 1, latency_us);
+        if (err < 0) {
+          snd_pcm_close (pcm_);
+          check (err, "Cannot configure " + device);
+        }
+      }
+
+      ~AlsaSink()
+      {
+        snd_pcm_drain (pcm_);
+        snd_pcm_close (pcm_);
+      }
+
+      void
+      write (const int16_t* frames,
+             size_t count)
+      {
+        while (count > 0) {
+          snd_pcm_sframes_t written = snd_pcm_writei (pcm_, frames, count);
+          if (written < 0) {
+            // Underruns and suspends are recovered silently
+            check (snd_pcm_recover (pcm_, written, 1), "Playback failed");
+            continue;
+          }
+          frames += written;
+          count -= written;
+        }
+      }
+
+      size_t
+      delay()
+      {
+        snd_pcm_sframes_t frames;
+        if ( (snd_pcm_delay (pcm_, &frames) < 0) || (frames < 0)) {
+          return 0;
+        }
+        return frames;
+      }
+  };
+
+
+
+  // Consumes frames in real time without a device, writing them to a WAV
+  // file when a path is given
+  class FileSink
+    : public Sink
+  {
+      const unsigned rate_;
+      FILE* file_;
+      uint32_t frames_;
+      Clock::time_point next_;
+
+      void
+      write_header()
+      {
+        uint32_t data = frames_ * sizeof (int16_t);
+        uint32_t riff = 36 + data;
+        uint32_t fmt_size = 16;
+        uint16_t format = 1;
+        uint16_t channels = 1;
+        uint32_t byte_rate = rate_ * sizeof (int16_t);
+        uint16_t block = sizeof (int16_t);
+        uint16_t bits = 16;
+
+        rewind (file_);
+        fwrite ("RIFF", 1, 4, file_);
+        fwrite (&riff, 4, 1, file_);
+        fwrite ("WAVEfmt ", 1, 8, file_);
+        fwrite (&fmt_size, 4, 1, file_);
+        fwrite (&format, 2, 1, file_);
+        fwrite (&channels, 2, 1, file_);
+        fwrite (&rate_, 4, 1, file_);
+        fwrite (&byte_rate, 4, 1, file_);
+        fwrite (&block, 2, 1, file_);
+        fwrite (&bits, 2, 1, file_);
+        fwrite ("data", 1, 4, file_);
+        fwrite (&data, 4, 1, file_);
+      }
+
+    public:
+      FileSink (std::string const& path,
+                unsigned rate)
+        : rate_ (rate)
+        , file_ (nullptr)
+        , frames_ (0)
+        , next_ (Clock::now())
+      {
+        if (! path.empty()) {
+          file_ = fopen (path.c_str(), "wb");
+          if (! file_) {
+            throw std::runtime_error ("Cannot open " + path);
+          }
+          write_header();
+        }
+      }
+
+      ~FileSink()
+      {
+        if (file_) {
+          write_header();
+          fclose (file_);
+        }
+      }
+
+      // Returns when the first frame would start playing
+      void
+      write (const int16_t* frames,
+             size_t count)
+      {
+        std::this_thread::sleep_until (next_);
+        next_ += std::chrono::duration_cast<Clock::duration> (std::chrono::duration<double> (static_cast<double> (count) / rate_));
+        if (file_) {
+          fwrite (frames, sizeof (int16_t), count, file_);
+        }
+        frames_ += count;
+      }
+
+      size_t
+      delay()
+      {
+        return 0;
+      }
+  };
+
+
+
+  class Engine
+  {
+      struct Voice {
+        Clip const* clip;
+        size_t pos;
+        Clock::time_point trigger;
+      };
+
+      // Reopens the output after it fails
+      const std::function<std::unique_ptr<Sink>() > open_;
+      std::unique_ptr<Sink> sink_;
+      const unsigned rate_;
+      const size_t period_;
+      const size_t max_voices_;
+      // Called from the mixer thread with the trigger to output latency
+      // of each clip, in seconds
+      const std::function<void (double) > started_;
+      // Called from the mixer thread when the output fails
+      const std::function<void (std::string const&) > failed_;
+
+      std::mutex mutex_;
+      std::vector<Voice> voices_;
+
+      std::atomic<bool> running_;
+      std::thread thread_;
+
+      void
+      run()
+      {
+        std::vector<int32_t> mix (period_);
+        std::vector<int16_t> out (period_);
+        std::vector<Clock::time_point> started;
+
+        while (running_) {
+          std::fill (mix.begin(), mix.end(), 0);
+          started.clear();
+          {
+            std::lock_guard<std::mutex> lock (mutex_);
+            for (auto v = voices_.begin(); v != voices_.end();) {
+              if (v->pos == 0) {
+                started.push_back (v->trigger);
+              }
+              size_t count = std::min (period_, v->clip->size() - v->pos);
+              for (size_t i = 0; i < count; ++i) {
+                mix[i] += (*v->clip) [v->pos + i];
+              }
+              v->pos += count;
+              if (v->pos == v->clip->size()) {
+                v = voices_.erase (v);
+              }
+              else {
+                ++v;
+              }
+            }
+          }
+          for (size_t i = 0; i < period_; ++i) {
+            out[i] = static_cast<int16_t> (std::max (-32768, std::min (32767, mix[i])));
+          }
+
+          try {
+            sink_->write (out.data(), period_);
+          }
+          catch (std::exception const& e) {
+            failed_ (e.what());
+            reopen();
+            continue;
+          }
+
+          if (! started.empty()) {
+            size_t delay = sink_->delay();
+            double queued = delay > period_ ? static_cast<double> (delay - period_) / rate_ : 0;
+            Clock::time_point now = Clock::now();
+            for (auto const& trigger : started) {
+              started_ (std::chrono::duration<double> (now - trigger).count() + queued);
+            }
+          }
+        }
+      }
+
+      // Retries every second, clips triggered meanwhile are dropped
+      void
+      reopen()
+      {
+        sink_.reset();
+        while (running_) {
+          {
+            std::lock_guard<std::mutex> lock (mutex_);
+            voices_.clear();
+          }
+          std::this_thread::sleep_for (std::chrono::seconds (1));
+          try {
+            sink_ = open_();
+            return;
+          }
+          catch (std::exception const& e) {
+            failed_ (e.what());
+          }
+        }
+      }
+
+    public:
+      // open is called here, and again from the mixer thread when the
+      // output fails
+      Engine (std::function<std::unique_ptr<Sink>() > open,
+              unsigned rate,
+              size_t period,
+              size_t max_voices,
+              std::function<void (double) > started,
+              std::function<void (std::string const&) > failed)
+        : open_ (open)
+        , sink_ (open_())
+        , rate_ (rate)
+        , period_ (std::max<size_t> (period, 1))
+        , max_voices_ (std::max<size_t> (max_voices, 1))
+        , started_ (started)
+        , failed_ (failed)
+        , running_ (true)
+        , thread_ (&Engine::run, this)
+      {
+      }
+
+      Engine (Engine const&) = delete;
+      Engine& operator= (Engine const&) = delete;
+
+      ~Engine()
+      {
+        running_ = false;
+        thread_.join();
+      }
+
+      // clip must outlive the engine. The oldest clip is cut when too
+      // many are playing.
+      void
+      play (Clip const& clip)
+      {
+        if (clip.empty()) {
+          return;
+        }
+        std::lock_guard<std::mutex> lock (mutex_);
+        if (voices_.size() >= max_voices_) {
+          voices_.erase (voices_.begin());
+        }
+        voices_.push_back (Voice { &clip, 0, Clock::now() });
+      }
+  };
+}
+
+#endif
@@ -0,0 +1,246 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BMBOX_PAYLOAD_H__
+#define __BMBOX_PAYLOAD_H__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+
+
+/*
+ * Payloads exchanged with the BmBox.
+ *
+ * Goals are parsed into plain structs, once per distinct payload. Results
+ * are written by MapWriter, which produces the same bytes as building a
+ * YAML::Node and calling YAML::Dump, without building the tree.
+ */
+
+namespace bmbox_payload
+{
+  // Goal of fbm1h, fbm2h and omf, as received in TRANSMITTING_GOAL.
+  // Switch ids are as sent by the BmBox.
+  struct Goal {
+    std::vector<bool> initial_state;
+    std::vector<uint32_t> switches;
+  };
+
+  inline Goal
+  parse_goal (std::string const& payload)
+  {
+    Goal g;
+    YAML::Node node = YAML::Load (payload);
+    for (auto const& i : node[0]["initial_state"]) {
+      g.initial_state.push_back (i.as<int>() ? true : false);
+    }
+    for (auto const& i : node[0]["switches"]) {
+      g.switches.push_back (i.as<uint32_t>());
+    }
+    return g;
+  }
+
+  template<typename T, T (*Parse) (std::string const&)>
+  class Cache
+  {
+      std::unordered_map<std::string, std::shared_ptr<const T>> entries_;
+      size_t max_size_;
+
+    public:
+      Cache (size_t max_size = 64)
+        : max_size_ (max_size)
+      {
+      }
+
+      // Throws if the payload cannot be parsed; failures are not cached
+      std::shared_ptr<const T>
+      get (std::string const& payload)
+      {
+        auto i = entries_.find (payload);
+        if (i != entries_.end()) {
+          return i->second;
+        }
+
+        std::shared_ptr<const T> value = std::make_shared<const T> (Parse (payload));
+        if (entries_.size() >= max_size_) {
+          entries_.clear();
+        }
+        entries_[payload] = value;
+        return value;
+      }
+
+      size_t
+      size() const
+      {
+        return entries_.size();
+      }
+  };
+
+  typedef Cache<Goal, &parse_goal> GoalCache;
+
+  inline std::shared_ptr<const Goal>
+  goal (std::string const& payload)
+  {
+    static GoalCache cache;
+    return cache.get (payload);
+  }
+
+
+
+  // Same scalar text as YAML::Dump of a node holding the value
+  template<typename T>
+  inline std::string
+  scalar (T const& value)
+  {
+    return YAML::convert<T>::encode (value).Scalar();
+  }
+
+  inline bool
+  is_plain_word (std::string const& s)
+  {
+    static const char* const reserved[] = {
+      "y", "Y", "yes", "Yes", "YES", "n", "N", "no", "No", "NO",
+      "true", "True", "TRUE", "false", "False", "FALSE",
+      "on", "On", "ON", "off", "Off", "OFF", "null", "Null", "NULL"
+    };
+
+    if (s.empty() || (s.size() > 64)) {
+      return false;
+    }
+    if (! ( ( (s[0] >= 'a') && (s[0] <= 'z'))
+            || ( (s[0] >= 'A') && (s[0] <= 'Z'))
+            || (s[0] == '_'))) {
+      return false;
+    }
+    for (char c : s) {
+      if (! ( ( (c >= 'a') && (c <= 'z'))
+              || ( (c >= 'A') && (c <= 'Z'))
+              || ( (c >= '0') && (c <= '9'))
+              || (c == '_'))) {
+        return false;
+      }
+    }
+    for (const char* r : reserved) {
+      if (s == r) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  inline std::string
+  scalar (std::string const& value)
+  {
+    if (is_plain_word (value)) {
+      return value;
+    }
+    YAML::Emitter out;
+    out << value;
+    return out.c_str();
+  }
+
+  inline std::string
+  scalar (const char* value)
+  {
+    return scalar (std::string (value));
+  }
+
+  // Block sequence layout of the linked yaml-cpp, taken from YAML::Dump once
+  struct SequenceLayout {
+    std::string item;
+    std::string empty;
+
+    SequenceLayout()
+    {
+      YAML::Node one;
+      one["k"].push_back ("v");
+      std::string s = YAML::Dump (one);
+      item = s.substr (2, s.size() - 3);
+
+      YAML::Node none;
+      none["k"] = YAML::Node (YAML::NodeType::Sequence);
+      empty = YAML::Dump (none).substr (2);
+    }
+
+    static SequenceLayout const&
+    get()
+    {
+      static const SequenceLayout layout;
+      return layout;
+    }
+  };
+
+  // Block map of scalars and sequences of scalars, in insertion order
+  class MapWriter
+  {
+      std::string out_;
+
+      void
+      key (std::string const& k)
+      {
+        if (! out_.empty()) {
+          out_ += '\n';
+        }
+        out_ += scalar (k);
+        out_ += ':';
+      }
+
+    public:
+      template<typename T>
+      MapWriter&
+      add (std::string const& k,
+           T const& value)
+      {
+        key (k);
+        out_ += ' ';
+        out_ += scalar (value);
+        return *this;
+      }
+
+      template<typename T>
+      MapWriter&
+      add_sequence (std::string const& k,
+                    std::vector<T> const& values)
+      {
+        SequenceLayout const& layout = SequenceLayout::get();
+        key (k);
+        if (values.empty()) {
+          out_ += layout.empty;
+        }
+        for (T const& v : values) {
+          out_ += layout.item;
+          out_ += scalar (v);
+        }
+        return *this;
+      }
+
+      std::string const&
+      str() const
+      {
+        return out_;
+      }
+  };
+}
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Micro-benchmark of the BmBox payload codecs against plain yaml-cpp.
+ * Also checks that both produce the same results, and exits with an
+ * error when they do not.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "bmbox_payload.h"
+
+
+
+using namespace std;
+
+
+
+const string GOAL_PAYLOAD = "- initial_state: [0, 1, 1, 0, 0, 1, 0, 0, 1, 0]\n  switches: [2, 5, 7]\n";
+
+
+
+template<typename F>
+double
+ns_per_op (unsigned n,
+           F f)
+{
+  auto start = chrono::steady_clock::now();
+  for (unsigned i = 0; i < n; ++i) {
+    f();
+  }
+  auto end = chrono::steady_clock::now();
+  return chrono::duration_cast<chrono::nanoseconds> (end - start).count() / static_cast<double> (n);
+}
+
+
+
+string
+fbm1_result_yaml (double t)
+{
+  YAML::Node node;
+  node["item_class"] = string ("Mugs");
+  node["item_instance"] = string ("blue mug");
+  node["x"] = 1.25;
+  node["y"] = -0.5;
+  node["theta"] = 3.14159;
+  node["execution_time"] = t;
+  return YAML::Dump (node);
+}
+
+string
+fbm1_result_writer (double t)
+{
+  bmbox_payload::MapWriter w;
+  w.add ("item_class", string ("Mugs"));
+  w.add ("item_instance", string ("blue mug"));
+  w.add ("x", 1.25);
+  w.add ("y", -0.5);
+  w.add ("theta", 3.14159);
+  w.add ("execution_time", t);
+  return w.str();
+}
+
+string
+omf_result_yaml (vector<int> const& switches,
+                 double t,
+                 uint32_t damaged)
+{
+  YAML::Node node;
+  node["switches"] = YAML::Node (YAML::NodeType::Sequence);
+  for (auto const& i : switches) {
+    node["switches"].push_back (i);
+  }
+  node["execution_time"] = t;
+  node["damaged_switches"] = damaged;
+  return YAML::Dump (node);
+}
+
+string
+omf_result_writer (vector<int> const& switches,
+                   double t,
+                   uint32_t damaged)
+{
+  bmbox_payload::MapWriter w;
+  w.add_sequence ("switches", switches);
+  w.add ("execution_time", t);
+  w.add ("damaged_switches", damaged);
+  return w.str();
+}
+
+
+
+int
+main (int argc,
+      char* argv[])
+{
+  unsigned n = argc > 1 ? atoi (argv[1]) : 100000;
+  bool ok = true;
+
+  bmbox_payload::Goal a = bmbox_payload::parse_goal (GOAL_PAYLOAD);
+  bmbox_payload::Goal b = *bmbox_payload::goal (GOAL_PAYLOAD);
+  if ( (a.initial_state != b.initial_state) || (a.switches != b.switches)) {
+    cerr << "Goal mismatch" << endl;
+    ok = false;
+  }
+  for (double t : {0.0, 1.0 / 3, 12.5, 1e-7, 123456.789}) {
+    if (fbm1_result_yaml (t) != fbm1_result_writer (t)) {
+      cerr << "fbm1h result mismatch:" << endl << fbm1_result_yaml (t) << endl << fbm1_result_writer (t) << endl;
+      ok = false;
+    }
+    for (vector<int> const& s : vector<vector<int>> { {}, {1}, {0, 4, 9}}) {
+      if (omf_result_yaml (s, t, 2) != omf_result_writer (s, t, 2)) {
+        cerr << "omf result mismatch:" << endl << omf_result_yaml (s, t, 2) << endl << omf_result_writer (s, t, 2) << endl;
+        ok = false;
+      }
+    }
+  }
+
+  size_t sink = 0;
+  cout << "goal YAML::Load:     " << ns_per_op (n, [&]() {
+    sink += bmbox_payload::parse_goal (GOAL_PAYLOAD).switches.size();
+  }) << " ns" << endl;
+  cout << "goal cached:         " << ns_per_op (n, [&]() {
+    sink += bmbox_payload::goal (GOAL_PAYLOAD)->switches.size();
+  }) << " ns" << endl;
+  cout << "fbm1h YAML::Dump:    " << ns_per_op (n, [&]() {
+    sink += fbm1_result_yaml (1.5).size();
+  }) << " ns" << endl;
+  cout << "fbm1h MapWriter:     " << ns_per_op (n, [&]() {
+    sink += fbm1_result_writer (1.5).size();
+  }) << " ns" << endl;
+  vector<int> switches = {1, 4, 6};
+  cout << "omf YAML::Dump:      " << ns_per_op (n, [&]() {
+    sink += omf_result_yaml (switches, 1.5, 1).size();
+  }) << " ns" << endl;
+  cout << "omf MapWriter:       " << ns_per_op (n, [&]() {
+    sink += omf_result_writer (switches, 1.5, 1).size();
+  }) << " ns" << endl;
+
+  if (sink == 0) {
+    cerr << "unexpected" << endl;
+  }
+  return ok ? 0 : 1;
+}
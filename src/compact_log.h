@@ -0,0 +1,738 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __COMPACT_LOG_H__
+#define __COMPACT_LOG_H__
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+
+
+/*
+ * Compact append-only log of RSBB events.
+ *
+ * File layout:
+ *   "RSBBLOG1"
+ *   record*
+ *   index record, with the name, count, first and last time and first
+ *     offset of each topic, and a time index every 256 events
+ *   trailer: uint64 little endian offset of the index record, "RSBBIDX2"
+ *
+ * Records start with a tag byte. Topic names are defined once with a
+ * TOPIC record and referenced by small integer IDs. Event times are
+ * nanoseconds, zigzag varint encoded as a delta from the previous event.
+ *
+ * Opening a closed log only reads the trailer and the index, and events
+ * are read from the nearest time index entry on. If the writer did not
+ * close the file (crash), the trailer is missing and the reader rebuilds
+ * the index by scanning the records. Logs ending in "RSBBIDX1" have no
+ * topic names in the index, which are then read from the records.
+ */
+
+namespace compact_log
+{
+  const char MAGIC[] = "RSBBLOG1";
+  const char INDEX_MAGIC[] = "RSBBIDX2";
+  const char INDEX_MAGIC_V1[] = "RSBBIDX1";
+  const size_t MAGIC_SIZE = 8;
+  const size_t TRAILER_SIZE = 16;
+  const size_t TIME_INDEX_INTERVAL = 256;
+
+  enum Tag {
+    TAG_TOPIC = 0x01,
+    TAG_EMPTY = 0x02,
+    TAG_UINT8 = 0x03,
+    TAG_STRING = 0x04,
+    TAG_SCORE = 0x05,
+    TAG_INDEX = 0x7F,
+  };
+
+  inline void
+  put_varint (std::string& out,
+              uint64_t v)
+  {
+    while (v >= 0x80) {
+      out.push_back (static_cast<char> ( (v & 0x7F) | 0x80));
+      v >>= 7;
+    }
+    out.push_back (static_cast<char> (v));
+  }
+
+  inline void
+  put_zigzag (std::string& out,
+              int64_t v)
+  {
+    put_varint (out, (static_cast<uint64_t> (v) << 1) ^ static_cast<uint64_t> (v >> 63));
+  }
+
+  inline void
+  put_bytes (std::string& out,
+             std::string const& s)
+  {
+    put_varint (out, s.size());
+    out.append (s);
+  }
+
+  inline uint64_t
+  get_varint (char const*& p,
+              char const* end)
+  {
+    uint64_t v = 0;
+    for (unsigned shift = 0; p < end; shift += 7) {
+      if (shift >= 64) {
+        throw std::runtime_error ("compact_log: varint too long");
+      }
+      uint8_t b = static_cast<uint8_t> (*p++);
+      v |= static_cast<uint64_t> (b & 0x7F) << shift;
+      if (! (b & 0x80)) {
+        return v;
+      }
+    }
+    throw std::runtime_error ("compact_log: truncated varint");
+  }
+
+  inline int64_t
+  get_zigzag (char const*& p,
+              char const* end)
+  {
+    uint64_t v = get_varint (p, end);
+    return static_cast<int64_t> (v >> 1) ^ - static_cast<int64_t> (v & 1);
+  }
+
+  inline void
+  get_bytes (char const*& p,
+             char const* end,
+             std::string& out)
+  {
+    uint64_t len = get_varint (p, end);
+    if (static_cast<uint64_t> (end - p) < len) {
+      throw std::runtime_error ("compact_log: truncated string");
+    }
+    out.assign (p, len);
+    p += len;
+  }
+
+  inline void
+  skip_bytes (char const*& p,
+              char const* end)
+  {
+    uint64_t len = get_varint (p, end);
+    if (static_cast<uint64_t> (end - p) < len) {
+      throw std::runtime_error ("compact_log: truncated string");
+    }
+    p += len;
+  }
+
+
+
+  struct TopicIndex {
+    std::string name;
+    uint64_t count;
+    uint64_t first_time;
+    uint64_t last_time;
+    uint64_t first_offset;
+
+    TopicIndex()
+      : count (0)
+      , first_time (0)
+      , last_time (0)
+      , first_offset (0)
+    {
+    }
+  };
+
+  // Offset of an event record and the time its delta is relative to
+  struct TimeIndex {
+    uint64_t time;
+    uint64_t base_time;
+    uint64_t offset;
+  };
+
+  struct Event {
+    uint32_t topic;
+    uint64_t time;
+    Tag type;
+    uint8_t u8;
+    std::string text;
+    std::string group;
+    int32_t value;
+  };
+
+
+
+  class Writer
+    : boost::noncopyable
+  {
+      FILE* file_;
+      uint64_t offset_;
+      uint64_t last_time_;
+      uint64_t events_;
+      std::map<std::string, uint32_t> topic_ids_;
+      std::vector<TopicIndex> topics_;
+      std::vector<TimeIndex> time_index_;
+      std::string buf_;
+
+      void
+      write_buf()
+      {
+        if (fwrite (buf_.data(), 1, buf_.size(), file_) != buf_.size()) {
+          throw std::runtime_error ("compact_log: write failed");
+        }
+        offset_ += buf_.size();
+        buf_.clear();
+      }
+
+      uint32_t
+      topic_id (std::string const& topic)
+      {
+        auto i = topic_ids_.find (topic);
+        if (i != topic_ids_.end()) {
+          return i->second;
+        }
+        uint32_t id = topics_.size();
+        topic_ids_[topic] = id;
+        topics_.push_back (TopicIndex());
+        topics_.back().name = topic;
+
+        buf_.push_back (static_cast<char> (TAG_TOPIC));
+        put_varint (buf_, id);
+        put_bytes (buf_, topic);
+        write_buf();
+        return id;
+      }
+
+      // Starts an event record in buf_
+      void
+      begin_event (Tag tag,
+                   std::string const& topic,
+                   uint64_t time)
+      {
+        uint32_t id = topic_id (topic);
+
+        TopicIndex& ti = topics_[id];
+        if (ti.count == 0) {
+          ti.first_time = time;
+          ti.first_offset = offset_;
+        }
+        ti.last_time = time;
+        ++ti.count;
+
+        if ( (events_ % TIME_INDEX_INTERVAL) == 0) {
+          TimeIndex idx;
+          idx.time = time;
+          idx.base_time = last_time_;
+          idx.offset = offset_;
+          time_index_.push_back (idx);
+        }
+        ++events_;
+
+        buf_.push_back (static_cast<char> (tag));
+        put_varint (buf_, id);
+        put_zigzag (buf_, static_cast<int64_t> (time - last_time_));
+        last_time_ = time;
+      }
+
+      void
+      end_event()
+      {
+        write_buf();
+        fflush (file_);
+      }
+
+    public:
+      Writer()
+        : file_ (nullptr)
+        , offset_ (0)
+        , last_time_ (0)
+        , events_ (0)
+      {
+      }
+
+      // A failed index write leaves an unclosed log, which readers recover
+      ~Writer()
+      {
+        try {
+          close();
+        }
+        catch (std::exception const& e) {
+          fprintf (stderr, "%s\n", e.what());
+        }
+      }
+
+      void
+      open (std::string const& path)
+      {
+        close();
+        file_ = fopen (path.c_str(), "wb");
+        if (! file_) {
+          throw std::runtime_error ("compact_log: could not open " + path);
+        }
+        offset_ = 0;
+        last_time_ = 0;
+        events_ = 0;
+        topic_ids_.clear();
+        topics_.clear();
+        time_index_.clear();
+        buf_.assign (MAGIC, MAGIC_SIZE);
+        write_buf();
+      }
+
+      bool
+      is_open() const
+      {
+        return file_ != nullptr;
+      }
+
+      void
+      close()
+      {
+        if (! file_) {
+          return;
+        }
+
+        uint64_t index_offset = offset_;
+        buf_.push_back (static_cast<char> (TAG_INDEX));
+        put_varint (buf_, topics_.size());
+        for (TopicIndex const& ti : topics_) {
+          put_bytes (buf_, ti.name);
+          put_varint (buf_, ti.count);
+          put_varint (buf_, ti.first_time);
+          put_varint (buf_, ti.last_time);
+          put_varint (buf_, ti.first_offset);
+        }
+        put_varint (buf_, time_index_.size());
+        for (TimeIndex const& i : time_index_) {
+          put_varint (buf_, i.time);
+          put_varint (buf_, i.base_time);
+          put_varint (buf_, i.offset);
+        }
+        for (unsigned i = 0; i < 8; ++i) {
+          buf_.push_back (static_cast<char> ( (index_offset >> (8 * i)) & 0xFF));
+        }
+        buf_.append (INDEX_MAGIC, MAGIC_SIZE);
+
+        FILE* file = file_;
+        try {
+          write_buf();
+        }
+        catch (...) {
+          fclose (file);
+          file_ = nullptr;
+          buf_.clear();
+          throw;
+        }
+        file_ = nullptr;
+        if (fclose (file) != 0) {
+          throw std::runtime_error ("compact_log: write failed");
+        }
+      }
+
+      void
+      write_empty (std::string const& topic,
+                   uint64_t time)
+      {
+        begin_event (TAG_EMPTY, topic, time);
+        end_event();
+      }
+
+      void
+      write_uint8 (std::string const& topic,
+                   uint64_t time,
+                   uint8_t v)
+      {
+        begin_event (TAG_UINT8, topic, time);
+        buf_.push_back (static_cast<char> (v));
+        end_event();
+      }
+
+      void
+      write_string (std::string const& topic,
+                    uint64_t time,
+                    std::string const& s)
+      {
+        begin_event (TAG_STRING, topic, time);
+        put_bytes (buf_, s);
+        end_event();
+      }
+
+      void
+      write_score (std::string const& topic,
+                   uint64_t time,
+                   std::string const& group,
+                   std::string const& desc,
+                   int32_t value)
+      {
+        begin_event (TAG_SCORE, topic, time);
+        put_bytes (buf_, group);
+        put_bytes (buf_, desc);
+        put_zigzag (buf_, value);
+        end_event();
+      }
+  };
+
+
+
+  class Reader
+    : boost::noncopyable
+  {
+      FILE* file_;
+      uint64_t records_end_;
+      std::vector<TopicIndex> topics_;
+      std::vector<TimeIndex> time_index_;
+
+      void
+      read_at (uint64_t offset,
+               uint64_t size,
+               std::string& out) const
+      {
+        out.resize (size);
+        if ( (fseeko (file_, offset, SEEK_SET) != 0)
+             || (fread (&out[0], 1, size, file_) != size)) {
+          throw std::runtime_error ("compact_log: read failed");
+        }
+      }
+
+      // Decodes the body of an event record whose tag was already
+      // consumed, skipping the payload unless asked for
+      static void
+      decode_event (Tag tag,
+                    char const*& p,
+                    char const* end,
+                    uint64_t& last_time,
+                    Event& e,
+                    bool payload)
+      {
+        e.type = tag;
+        e.topic = get_varint (p, end);
+        e.time = last_time = last_time + get_zigzag (p, end);
+        switch (tag) {
+          case TAG_UINT8:
+            if (p >= end) {
+              throw std::runtime_error ("compact_log: truncated uint8");
+            }
+            e.u8 = static_cast<uint8_t> (*p++);
+            break;
+          case TAG_STRING:
+            if (payload) {
+              get_bytes (p, end, e.text);
+            }
+            else {
+              skip_bytes (p, end);
+            }
+            break;
+          case TAG_SCORE:
+            if (payload) {
+              get_bytes (p, end, e.group);
+              get_bytes (p, end, e.text);
+            }
+            else {
+              skip_bytes (p, end);
+              skip_bytes (p, end);
+            }
+            e.value = static_cast<int32_t> (get_zigzag (p, end));
+            break;
+          default:
+            break;
+        }
+      }
+
+      // Reads the topic definitions from the records, and rebuilds the
+      // index too unless the log has one
+      void
+      scan (bool indexed)
+      {
+        std::string data;
+        read_at (MAGIC_SIZE, records_end_ - MAGIC_SIZE, data);
+        char const* begin = data.data();
+        char const* p = begin;
+        char const* end = begin + data.size();
+        uint64_t last_time = 0;
+        uint64_t events = 0;
+        Event e;
+        char const* record = p;
+        try {
+          while (p < end) {
+            record = p;
+            uint64_t base_time = last_time;
+            Tag tag = static_cast<Tag> (static_cast<uint8_t> (*p++));
+            if (tag == TAG_TOPIC) {
+              uint64_t id = get_varint (p, end);
+              if (id != topics_.size()) {
+                throw std::runtime_error ("compact_log: topic ids out of order");
+              }
+              topics_.push_back (TopicIndex());
+              get_bytes (p, end, topics_.back().name);
+              continue;
+            }
+            if ( (tag != TAG_EMPTY) && (tag != TAG_UINT8) && (tag != TAG_STRING) && (tag != TAG_SCORE)) {
+              throw std::runtime_error ("compact_log: unknown record tag");
+            }
+            decode_event (tag, p, end, last_time, e, false);
+            if (e.topic >= topics_.size()) {
+              throw std::runtime_error ("compact_log: undefined topic id");
+            }
+            if (indexed) {
+              continue;
+            }
+
+            uint64_t offset = MAGIC_SIZE + (record - begin);
+            TopicIndex& ti = topics_[e.topic];
+            if (ti.count == 0) {
+              ti.first_time = e.time;
+              ti.first_offset = offset;
+            }
+            ti.last_time = e.time;
+            ++ti.count;
+            if ( (events % TIME_INDEX_INTERVAL) == 0) {
+              TimeIndex idx;
+              idx.time = e.time;
+              idx.base_time = base_time;
+              idx.offset = offset;
+              time_index_.push_back (idx);
+            }
+            ++events;
+          }
+        }
+        catch (std::runtime_error const&) {
+          if (indexed) {
+            throw;
+          }
+          // Truncated tail of an unclosed log, keep what was decoded
+          records_end_ = MAGIC_SIZE + (record - begin);
+        }
+      }
+
+      void
+      load_index (uint64_t index_offset,
+                  uint64_t file_size,
+                  bool names)
+      {
+        std::string data;
+        read_at (index_offset + 1, file_size - TRAILER_SIZE - index_offset - 1, data);
+        char const* p = data.data();
+        char const* end = p + data.size();
+
+        uint64_t n = get_varint (p, end);
+        if (names) {
+          if (n > data.size()) {
+            throw std::runtime_error ("compact_log: bad index");
+          }
+          topics_.resize (n);
+        }
+        else if (n != topics_.size()) {
+          throw std::runtime_error ("compact_log: index does not match topics");
+        }
+        for (TopicIndex& ti : topics_) {
+          if (names) {
+            get_bytes (p, end, ti.name);
+          }
+          ti.count = get_varint (p, end);
+          ti.first_time = get_varint (p, end);
+          ti.last_time = get_varint (p, end);
+          ti.first_offset = get_varint (p, end);
+        }
+        n = get_varint (p, end);
+        if (n > data.size()) {
+          throw std::runtime_error ("compact_log: bad index");
+        }
+        time_index_.resize (n);
+        for (TimeIndex& i : time_index_) {
+          i.time = get_varint (p, end);
+          i.base_time = get_varint (p, end);
+          i.offset = get_varint (p, end);
+          if ( (i.offset < MAGIC_SIZE) || (i.offset > records_end_)) {
+            throw std::runtime_error ("compact_log: bad index");
+          }
+        }
+      }
+
+    public:
+      Reader()
+        : file_ (nullptr)
+        , records_end_ (0)
+      {
+      }
+
+      ~Reader()
+      {
+        close();
+      }
+
+      void
+      open (std::string const& path)
+      {
+        close();
+        topics_.clear();
+        time_index_.clear();
+
+        file_ = fopen (path.c_str(), "rb");
+        if (! file_) {
+          throw std::runtime_error ("compact_log: could not open " + path);
+        }
+        if (fseeko (file_, 0, SEEK_END) != 0) {
+          throw std::runtime_error ("compact_log: could not read " + path);
+        }
+        uint64_t size = ftello (file_);
+
+        std::string buf;
+        if ( (size < MAGIC_SIZE)
+             || (read_at (0, MAGIC_SIZE, buf), buf.compare (0, MAGIC_SIZE, MAGIC, MAGIC_SIZE) != 0)) {
+          throw std::runtime_error ("compact_log: bad magic in " + path);
+        }
+        records_end_ = size;
+
+        // 2: index with topic names, 1: index without them, 0: no index
+        int version = 0;
+        uint64_t index_offset = 0;
+        if (size >= MAGIC_SIZE + TRAILER_SIZE) {
+          read_at (size - TRAILER_SIZE, TRAILER_SIZE, buf);
+          if (buf.compare (8, MAGIC_SIZE, INDEX_MAGIC, MAGIC_SIZE) == 0) {
+            version = 2;
+          }
+          else if (buf.compare (8, MAGIC_SIZE, INDEX_MAGIC_V1, MAGIC_SIZE) == 0) {
+            version = 1;
+          }
+          for (unsigned i = 0; i < 8; ++i) {
+            index_offset |= static_cast<uint64_t> (static_cast<uint8_t> (buf[i])) << (8 * i);
+          }
+          if (version
+              && ( (index_offset < MAGIC_SIZE) || (index_offset >= size - TRAILER_SIZE)
+                   || (read_at (index_offset, 1, buf), static_cast<uint8_t> (buf[0]) != TAG_INDEX))) {
+            version = 0;
+          }
+        }
+
+        if (version == 0) {
+          scan (false);
+          return;
+        }
+        records_end_ = index_offset;
+        if (version == 1) {
+          scan (true);
+        }
+        load_index (index_offset, size, version == 2);
+      }
+
+      void
+      close()
+      {
+        if (file_) {
+          fclose (file_);
+          file_ = nullptr;
+        }
+      }
+
+      std::vector<TopicIndex> const&
+      topics() const
+      {
+        return topics_;
+      }
+
+      std::string const&
+      topic_name (uint32_t id) const
+      {
+        return topics_.at (id).name;
+      }
+
+      // Id of topic, or -1 when the log has none of it
+      int64_t
+      topic_id (std::string const& topic) const
+      {
+        for (size_t i = 0; i < topics_.size(); ++i) {
+          if (topics_[i].name == topic) {
+            return i;
+          }
+        }
+        return -1;
+      }
+
+      // Calls f (Event const&) for every event with time >= from, of the
+      // topics in wanted, or of all when it is empty. Reading starts at
+      // the time index entry before from and before the first event of the
+      // wanted topics, and other events are skipped without copying their
+      // payload. The time index assumes event times do not go backwards.
+      template<typename F> void
+      for_each (F f,
+                uint64_t from = 0,
+                std::vector<uint32_t> const& wanted = std::vector<uint32_t>()) const
+      {
+        std::vector<char> want (topics_.size(), wanted.empty());
+        uint64_t left = 0;
+        uint64_t first_offset = records_end_;
+        for (uint32_t id : wanted) {
+          if ( (id < topics_.size()) && ! want[id]) {
+            want[id] = true;
+            left += topics_[id].count;
+            first_offset = std::min (first_offset, topics_[id].first_offset);
+          }
+        }
+        if (! wanted.empty() && (left == 0)) {
+          return;
+        }
+
+        uint64_t start = MAGIC_SIZE;
+        uint64_t last_time = 0;
+        for (TimeIndex const& i : time_index_) {
+          if ( (i.time > from) || (! wanted.empty() && (i.offset > first_offset))) {
+            break;
+          }
+          start = i.offset;
+          last_time = i.base_time;
+        }
+
+        std::string data;
+        read_at (start, records_end_ - start, data);
+        char const* p = data.data();
+        char const* end = p + data.size();
+
+        Event e;
+        while (p < end) {
+          Tag tag = static_cast<Tag> (static_cast<uint8_t> (*p++));
+          if (tag == TAG_TOPIC) {
+            // Already known from open()
+            get_varint (p, end);
+            skip_bytes (p, end);
+            continue;
+          }
+          char const* q = p;
+          uint64_t topic = get_varint (q, end);
+          bool wanted_topic = (topic < want.size()) && want[topic];
+          decode_event (tag, p, end, last_time, e, wanted_topic);
+          if (! wanted_topic) {
+            continue;
+          }
+          if (e.time >= from) {
+            f (e);
+          }
+          if (! wanted.empty() && (--left == 0)) {
+            break;
+          }
+        }
+      }
+  };
+}
+
+#endif
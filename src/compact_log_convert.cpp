@@ -0,0 +1,173 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+
+#include <std_msgs/Empty.h>
+#include <std_msgs/String.h>
+#include <std_msgs/UInt8.h>
+#include <roah_rsbb/Score.h>
+
+#include "compact_log.h"
+
+
+
+using namespace std;
+using namespace ros;
+
+
+
+void
+to_bag (string const& in,
+        string const& out)
+{
+  compact_log::Reader reader;
+  reader.open (in);
+
+  rosbag::Bag bag;
+  bag.open (out, rosbag::bagmode::Write);
+
+  reader.for_each ([&] (compact_log::Event const & e) {
+    Time time;
+    time.fromNSec (e.time);
+    string const& topic = reader.topic_name (e.topic);
+    switch (e.type) {
+      case compact_log::TAG_EMPTY: {
+        std_msgs::Empty msg;
+        bag.write (topic, time, msg);
+        break;
+      }
+      case compact_log::TAG_UINT8: {
+        std_msgs::UInt8 msg;
+        msg.data = e.u8;
+        bag.write (topic, time, msg);
+        break;
+      }
+      case compact_log::TAG_STRING: {
+        std_msgs::String msg;
+        msg.data = e.text;
+        bag.write (topic, time, msg);
+        break;
+      }
+      case compact_log::TAG_SCORE: {
+        roah_rsbb::Score msg;
+        msg.group = e.group;
+        msg.desc = e.text;
+        msg.value = e.value;
+        bag.write (topic, time, msg);
+        break;
+      }
+      default:
+        break;
+    }
+  });
+
+  bag.close();
+}
+
+
+
+void
+from_bag (string const& in,
+          string const& out)
+{
+  rosbag::Bag bag;
+  bag.open (in, rosbag::bagmode::Read);
+
+  compact_log::Writer writer;
+  writer.open (out);
+
+  rosbag::View view (bag);
+  for (rosbag::MessageInstance const& m : view) {
+    uint64_t time = m.getTime().toNSec();
+    if (m.isType<std_msgs::Empty>()) {
+      writer.write_empty (m.getTopic(), time);
+    }
+    else if (std_msgs::UInt8::ConstPtr msg = m.instantiate<std_msgs::UInt8>()) {
+      writer.write_uint8 (m.getTopic(), time, msg->data);
+    }
+    else if (std_msgs::String::ConstPtr msg = m.instantiate<std_msgs::String>()) {
+      writer.write_string (m.getTopic(), time, msg->data);
+    }
+    else if (roah_rsbb::Score::ConstPtr msg = m.instantiate<roah_rsbb::Score>()) {
+      writer.write_score (m.getTopic(), time, msg->group, msg->desc, msg->value);
+    }
+    else {
+      cerr << "Skipping " << m.getTopic() << " of unsupported type " << m.getDataType() << endl;
+    }
+  }
+
+  writer.close();
+  bag.close();
+}
+
+
+
+void
+info (string const& in)
+{
+  compact_log::Reader reader;
+  reader.open (in);
+
+  for (compact_log::TopicIndex const& ti : reader.topics()) {
+    Time first, last;
+    first.fromNSec (ti.first_time);
+    last.fromNSec (ti.last_time);
+    cout << ti.name << ": " << ti.count << " events, " << first << " - " << last << endl;
+  }
+}
+
+
+
+int
+main (int argc,
+      char* argv[])
+{
+  Time::init();
+
+  string cmd = argc > 1 ? argv[1] : "";
+  try {
+    if ( (cmd == "to_bag") && (argc == 4)) {
+      to_bag (argv[2], argv[3]);
+    }
+    else if ( (cmd == "from_bag") && (argc == 4)) {
+      from_bag (argv[2], argv[3]);
+    }
+    else if ( (cmd == "info") && (argc == 3)) {
+      info (argv[2]);
+    }
+    else {
+      cerr << "Usage:" << endl
+           << "  " << argv[0] << " to_bag <in.rlog> <out.bag>" << endl
+           << "  " << argv[0] << " from_bag <in.bag> <out.rlog>" << endl
+           << "  " << argv[0] << " info <in.rlog>" << endl;
+      return 1;
+    }
+  }
+  catch (std::exception const& e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
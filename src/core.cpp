@@ -19,6 +19,10 @@
 
 #include "core_includes.h"
 
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
 #include "core_shared_state.h"
 #include "core_public_channel.h"
 #include "core_zone_manager.h"
@@ -27,6 +31,42 @@
 
 
 
+// Every heap allocation of the core goes through here to be counted
+static std::atomic<uint64_t> allocations (0);
+static thread_local uint64_t thread_allocations = 0;
+
+uint64_t
+allocation_count()
+{
+  return allocations.load (std::memory_order_relaxed);
+}
+
+uint64_t
+thread_allocation_count()
+{
+  return thread_allocations;
+}
+
+void*
+operator new (size_t size)
+{
+  allocations.fetch_add (1, std::memory_order_relaxed);
+  ++thread_allocations;
+  void* p = malloc (size ? size : 1);
+  if (! p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void
+operator delete (void* p) noexcept
+{
+  free (p);
+}
+
+
+
 namespace roah_rsbb
 {
   class Core
@@ -42,7 +82,20 @@ namespace roah_rsbb
       void
       devices_callback (roah_devices::DevicesState::ConstPtr const& msg)
       {
+        Time now = Time::now();
+        roah_devices::DevicesState const& last = *ss_.last_devices_state;
+        bool changed = (last.bell != msg->bell)
+                       || (last.switch_1 != msg->switch_1)
+                       || (last.switch_2 != msg->switch_2)
+                       || (last.switch_3 != msg->switch_3)
+                       || (last.dimmer != msg->dimmer)
+                       || (last.blinds != msg->blinds);
+
         ss_.last_devices_state = msg;
+
+        if (changed) {
+          public_channel_.push_beacon (now);
+        }
       }
 
     public:
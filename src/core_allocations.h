@@ -0,0 +1,94 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_ALLOCATIONS_H__
+#define __CORE_ALLOCATIONS_H__
+
+#include "core_includes.h"
+
+
+
+// Heap allocations made by the core so far, counted in core.cpp
+uint64_t
+allocation_count();
+
+// Heap allocations made so far by the calling thread
+uint64_t
+thread_allocation_count();
+
+
+
+/*
+ * Counts the messages of one type and the heap allocations made by the
+ * core while handling them. The decoding itself happens in the channel
+ * library before the handlers run and is not counted here.
+ */
+class AllocationCounter
+  : boost::noncopyable
+{
+    const string name_;
+    uint64_t messages_;
+    uint64_t allocations_;
+    uint64_t last_;
+
+  public:
+    // Counts the allocations of the calling thread while it lives
+    class Scope
+      : boost::noncopyable
+    {
+        AllocationCounter& counter_;
+        const unsigned messages_;
+        const uint64_t start_;
+
+      public:
+        Scope (AllocationCounter& counter,
+               unsigned messages = 1)
+          : counter_ (counter)
+          , messages_ (messages)
+          , start_ (thread_allocation_count())
+        {
+        }
+
+        ~Scope()
+        {
+          uint64_t n = thread_allocation_count() - start_;
+          counter_.messages_ += messages_;
+          counter_.allocations_ += n;
+          counter_.last_ = n;
+        }
+    };
+
+    AllocationCounter (string const& name)
+      : name_ (name)
+      , messages_ (0)
+      , allocations_ (0)
+      , last_ (0)
+    {
+    }
+
+    string
+    str() const
+    {
+      ostringstream o;
+      o << name_ << ": " << messages_ << " messages, " << allocations_ << " allocations, " << last_ << " last";
+      return o.str();
+    }
+};
+
+#endif
@@ -22,6 +22,8 @@
 
 #include "core_includes.h"
 
+#include "udp_batch.h"
+
 
 
 class add_to_sting
@@ -48,6 +50,24 @@ class add_to_sting
 
 
 
+// Assigns element n of a vector being refilled in place, so that the
+// element keeps its storage from the previous fill
+template<typename T, typename V>
+void
+set_element (vector<T>& v,
+             size_t n,
+             V const& value)
+{
+  if (n < v.size()) {
+    v[n] = value;
+  }
+  else {
+    v.push_back (value);
+  }
+}
+
+
+
 void
 abort_rsbb()
 {
@@ -68,13 +88,58 @@ abort_rsbb()
 
 
 
+// Error in a configuration file, fatal at startup and reported on reload
+class ConfigError
+  : public runtime_error
+{
+  public:
+    ConfigError (string const& what)
+      : runtime_error (what)
+    {
+    }
+};
+
+
+
+// Loads a configuration file at startup, aborting on errors
+template<typename T> T
+load_config (string const& file)
+{
+  try {
+    return T (file);
+  }
+  catch (std::exception const& e) {
+    ROS_FATAL_STREAM ("Error loading " << file << ": " << e.what());
+    abort_rsbb();
+    throw;
+  }
+}
+
+
+
+// The channels bind to the wildcard address, so joining a multicast group
+// from any socket of the host is enough for them to receive it. Returns
+// an empty pointer when host is not a multicast group. Throws
+// std::runtime_error if the group cannot be joined.
+unique_ptr<udp_batch::Membership>
+join_if_multicast (string const& host)
+{
+  if (! udp_batch::is_multicast (host)) {
+    return unique_ptr<udp_batch::Membership>();
+  }
+  string interface = param_direct<string> ("~rsbb_multicast_interface", "");
+  ROS_INFO_STREAM ("Joining multicast group " << host << " on " << (interface.empty() ? "the default interface" : interface));
+  return unique_ptr<udp_batch::Membership> (new udp_batch::Membership (host, interface));
+}
+
+
+
 template<typename T> T
 yamlschedget (YAML::Node const& node,
               string const& key)
 {
   if (! node[key]) {
-    ROS_FATAL_STREAM ("Schedule file is missing a \"" << key << "\" entry!");
-    abort_rsbb();
+    throw ConfigError ("Schedule file is missing a \"" + key + "\" entry!");
   }
   return node[key].as<T>();
 }
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_BENCHMARK_TYPES_H__
+#define __CORE_BENCHMARK_TYPES_H__
+
+#include "core_includes.h"
+
+#include <deque>
+
+#include "core_aux.h"
+
+
+
+struct CoreSharedState;
+struct Event;
+class ExecutingBenchmark;
+
+
+
+enum BmBoxProtocol {
+  BMBOX_NONE,
+  BMBOX_FBM1,
+  BMBOX_FBM2,
+  BMBOX_OMF
+};
+
+
+
+/*
+ * Everything the core needs to know about a benchmark code. Codes are
+ * resolved to a BenchmarkType once, when the schedule is loaded, and
+ * executors read the flags they need when they are created.
+ */
+struct BenchmarkType {
+  typedef function<ExecutingBenchmark* (CoreSharedState&,
+                                        Event const&,
+                                        boost::function<void() >,
+                                        string const&) > Factory;
+
+  unsigned id;
+  string code;
+  // Executed with all active robots, scheduled for team ALL
+  bool all_robots;
+  // The robot may operate the home automation devices
+  bool devices_control;
+  BmBoxProtocol bmbox;
+  string bmbox_prefix;
+  Factory create;
+
+  BenchmarkType()
+    : id (0)
+    , all_robots (false)
+    , devices_control (false)
+    , bmbox (BMBOX_NONE)
+  {
+  }
+};
+
+
+
+class BenchmarkTypes
+  : boost::noncopyable
+{
+    // deque keeps references valid while adding
+    deque<BenchmarkType> types_;
+    map<string, unsigned> by_code_;
+
+  public:
+    BenchmarkType const&
+    add (BenchmarkType type)
+    {
+      if (by_code_.count (type.code)) {
+        ROS_FATAL_STREAM ("Benchmark type " << type.code << " registered twice");
+        abort_rsbb();
+      }
+      if (! type.create) {
+        ROS_FATAL_STREAM ("Benchmark type " << type.code << " registered without an executor");
+        abort_rsbb();
+      }
+
+      type.id = types_.size();
+      by_code_[type.code] = type.id;
+      types_.push_back (type);
+      return types_.back();
+    }
+
+    BenchmarkType const*
+    find (string const& code) const
+    {
+      auto i = by_code_.find (code);
+      if (i == by_code_.end()) {
+        return nullptr;
+      }
+      return &types_[i->second];
+    }
+
+    BenchmarkType const&
+    get (unsigned id) const
+    {
+      return types_.at (id);
+    }
+
+    size_t
+    size() const
+    {
+      return types_.size();
+    }
+};
+
+#endif
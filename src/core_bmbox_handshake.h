@@ -0,0 +1,138 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_BMBOX_HANDSHAKE_H__
+#define __CORE_BMBOX_HANDSHAKE_H__
+
+#include "core_includes.h"
+
+
+
+/*
+ * Publisher of ClientState or RefBoxState to the BmBox.
+ *
+ * Each new state gets a sequence number and is retransmitted with
+ * exponential backoff until acknowledged. The BmBox messages carry no
+ * sequence numbers, so the first BmBoxState change seen after a state
+ * is sent acknowledges it.
+ */
+template<typename M>
+class BmBoxStatePublisher
+  : boost::noncopyable
+{
+    Publisher pub_;
+    M msg_;
+
+    uint32_t seq_;
+    uint32_t acked_seq_;
+    Time sent_time_;
+    Time next_time_;
+    Duration interval_;
+    const Duration initial_interval_;
+    const Duration max_interval_;
+
+    Duration last_rtt_;
+    unsigned retransmissions_;
+
+  public:
+    BmBoxStatePublisher (NodeHandle& nh,
+                         string const& topic)
+      : pub_ (nh.advertise<M> (topic, 1, true))
+      , seq_ (0)
+      , acked_seq_ (0)
+      , initial_interval_ (param_direct<double> ("~bmbox_retransmit_initial", 0.2))
+      , max_interval_ (param_direct<double> ("~bmbox_retransmit_max", 5.0))
+      , retransmissions_ (0)
+    {
+    }
+
+    void
+    publish (Time const& now,
+             M const& msg)
+    {
+      msg_ = msg;
+      ++seq_;
+      sent_time_ = now;
+      interval_ = initial_interval_;
+      next_time_ = now + interval_;
+      pub_.publish (msg_);
+    }
+
+    void
+    ack (Time const& now)
+    {
+      if (pending()) {
+        last_rtt_ = now - sent_time_;
+        acked_seq_ = seq_;
+        ROS_DEBUG_STREAM ("BmBox acknowledged state " << static_cast<int> (msg_.state) << " (seq " << seq_ << ") in " << last_rtt_.toSec() << " s");
+      }
+    }
+
+    void
+    retransmit (Time const& now)
+    {
+      if (pending() && (now >= next_time_)) {
+        pub_.publish (msg_);
+        ++retransmissions_;
+        interval_ = interval_ + interval_;
+        if (interval_ > max_interval_) {
+          interval_ = max_interval_;
+        }
+        next_time_ = now + interval_;
+      }
+    }
+
+    bool
+    pending() const
+    {
+      return acked_seq_ != seq_;
+    }
+
+    typename M::_state_type
+    state() const
+    {
+      return msg_.state;
+    }
+
+    uint32_t
+    seq() const
+    {
+      return seq_;
+    }
+
+    Duration const&
+    last_rtt() const
+    {
+      return last_rtt_;
+    }
+
+    unsigned
+    retransmissions() const
+    {
+      return retransmissions_;
+    }
+
+    Time const&
+    sent_time() const
+    {
+      return sent_time_;
+    }
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_CLOCK_SKEW_H__
+#define __CORE_CLOCK_SKEW_H__
+
+#include "core_includes.h"
+
+#include <algorithm>
+
+
+
+/*
+ * Clock skew of one robot, filtered over a window of received messages.
+ *
+ * Each sample is the robot time of a message minus the time it was
+ * received, that is, the skew minus the network delay. As the delay is
+ * never negative, the largest sample in the window is the one with the
+ * smallest delay and the best estimate of the skew (the minimum delay
+ * filter of NTP). The distance of each sample to it is the delay above
+ * the minimum, whose distribution is the jitter of the link.
+ */
+class ClockSkewEstimator
+{
+    struct Sample {
+      Time received;
+      Duration skew;
+    };
+
+    const Duration window_;
+    // Ring of the samples in the window, allocated once
+    vector<Sample> samples_;
+    size_t head_;
+    size_t count_;
+    vector<Duration> delays_;
+
+    Duration skew_;
+    Duration last_;
+    Duration delay_median_;
+    Duration delay_p95_;
+
+    Sample const&
+    sample (size_t i) const
+    {
+      return samples_[ (head_ + i) % samples_.size()];
+    }
+
+    void
+    update()
+    {
+      skew_ = sample (0).skew;
+      for (size_t i = 1; i < count_; ++i) {
+        if (sample (i).skew > skew_) {
+          skew_ = sample (i).skew;
+        }
+      }
+
+      delays_.clear();
+      for (size_t i = 0; i < count_; ++i) {
+        delays_.push_back (skew_ - sample (i).skew);
+      }
+      size_t median = delays_.size() / 2;
+      nth_element (delays_.begin(), delays_.begin() + median, delays_.end());
+      delay_median_ = delays_[median];
+      size_t p95 = (delays_.size() * 95) / 100;
+      nth_element (delays_.begin(), delays_.begin() + p95, delays_.end());
+      delay_p95_ = delays_[p95];
+    }
+
+  public:
+    ClockSkewEstimator (Duration const& window,
+                        size_t max_samples)
+      : window_ (window)
+      , samples_ (max<size_t> (max_samples, 1))
+      , head_ (0)
+      , count_ (0)
+    {
+      delays_.reserve (samples_.size());
+    }
+
+    void
+    add (Time const& robot_time,
+         Time const& received)
+    {
+      last_ = robot_time - received;
+      if (count_ == samples_.size()) {
+        head_ = (head_ + 1) % samples_.size();
+        --count_;
+      }
+      samples_[ (head_ + count_) % samples_.size()] = Sample { received, last_ };
+      ++count_;
+      while ( (count_ > 1) && ( (sample (0).received + window_) < received)) {
+        head_ = (head_ + 1) % samples_.size();
+        --count_;
+      }
+      update();
+    }
+
+    size_t
+    samples() const
+    {
+      return count_;
+    }
+
+    // Filtered skew
+    Duration const&
+    skew() const
+    {
+      return skew_;
+    }
+
+    // Last unfiltered sample
+    Duration const&
+    last() const
+    {
+      return last_;
+    }
+
+    Duration const&
+    delay_median() const
+    {
+      return delay_median_;
+    }
+
+    Duration const&
+    delay_p95() const
+    {
+      return delay_p95_;
+    }
+};
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_FBM2_WAYPOINTS_H__
+#define __CORE_FBM2_WAYPOINTS_H__
+
+#include "core_includes.h"
+
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+
+#include "core_aux.h"
+
+
+
+struct Fbm2Config {
+  struct Pose {
+    double x;
+    double y;
+    double theta;
+  };
+
+  vector<double> starting_pose;
+  double penalty_time;
+  double timeout_time;
+  vector<Pose> waypoints;
+  // Text logged at the start of each run
+  string description;
+
+  Fbm2Config (string const& file)
+  {
+    YAML::Node config = YAML::LoadFile (file);
+
+    if (! config["goal"]["starting_pose"]) {
+      throw runtime_error ("FBM2H file is missing a \"starting_pose\" entry!");
+    }
+    starting_pose = config["goal"]["starting_pose"].as<vector<double>>();
+
+    if (! config["goal"]["penalty_time"]) {
+      throw runtime_error ("FBM2H file is missing a \"penalty_time\" entry!");
+    }
+    penalty_time = config["goal"]["penalty_time"].as<double>();
+
+    if (! config["goal"]["timeout_time"]) {
+      throw runtime_error ("FBM2H file is missing a \"timeout_time\" entry!");
+    }
+    timeout_time = config["goal"]["timeout_time"].as<double>();
+
+    if (! config["goal"]["waypoints"]) {
+      throw runtime_error ("FBM2H file is missing a \"waypoints\" entry!");
+    }
+    for (YAML::Node const& wp_node : config["goal"]["waypoints"]) {
+      vector<double> wp = wp_node.as<vector<double>>();
+      if (wp.size() < 3) {
+        throw runtime_error ("FBM2H file has a waypoint with less than 3 values!");
+      }
+      waypoints.push_back (Pose { wp[0], wp[1], wp[2] });
+    }
+
+    ostringstream pl;
+
+    pl << "RefBox - FBM2 Config:" << endl;
+    pl << "Penalty Time: " << penalty_time << endl;
+    pl << "Timeout Time: " << timeout_time << endl;
+
+    pl << "Starting Pose: [ ";
+    for (double i : starting_pose) {
+      pl << i << ' ';
+    }
+    pl << "]" << endl;
+
+    pl << "Waypoints: " << endl;
+    for (size_t i = 0; i < waypoints.size(); i++) {
+      pl << "\tWP #" << i << ": [ " << waypoints[i].x << ' ' << waypoints[i].y << ' ' << waypoints[i].theta << " ]" << endl;
+    }
+    pl << endl;
+
+    description = pl.str();
+  }
+};
+
+
+
+/*
+ * FBM2 configuration, loaded at startup and reloaded when the file
+ * changes. Running benchmarks keep the configuration they started with.
+ */
+class Fbm2Waypoints
+  : boost::noncopyable
+{
+    string file_;
+    std::shared_ptr<const Fbm2Config> config_;
+
+    int inotify_fd_;
+    Timer check_timer_;
+
+    void
+    load()
+    {
+      try {
+        config_ = make_shared<const Fbm2Config> (file_);
+        ROS_INFO_STREAM ("Loaded " << config_->waypoints.size() << " FBM2 waypoints from " << file_);
+      }
+      catch (std::exception const& e) {
+        ROS_ERROR_STREAM ("Could not load FBM2 configuration from " << file_ << ": " << e.what()
+                          << (config_ ? " (keeping previous)" : ""));
+      }
+    }
+
+    void
+    check (const TimerEvent& = TimerEvent())
+    {
+      // Watches the directory, as editors often replace the file
+      char buf[4096] __attribute__ ( (aligned (__alignof__ (struct inotify_event))));
+      string name = boost::filesystem::path (file_).filename().string();
+      bool changed = false;
+      ssize_t len;
+      while ( (len = read (inotify_fd_, buf, sizeof (buf))) > 0) {
+        for (char* p = buf; p < buf + len;) {
+          struct inotify_event const* ev = reinterpret_cast<struct inotify_event const*> (p);
+          if ( (ev->len > 0) && (name == ev->name)) {
+            changed = true;
+          }
+          p += sizeof (struct inotify_event) + ev->len;
+        }
+      }
+      if (changed) {
+        load();
+      }
+    }
+
+  public:
+    Fbm2Waypoints (NodeHandle& nh)
+      : file_ (param_direct<string> ("~fbm2_locations_file", ""))
+      , inotify_fd_ (-1)
+    {
+      if (file_.empty()) {
+        return;
+      }
+
+      load();
+
+      inotify_fd_ = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+      if (inotify_fd_ < 0) {
+        ROS_WARN_STREAM ("Cannot watch " << file_ << ", changes will not be reloaded");
+        return;
+      }
+      string dir = boost::filesystem::path (file_).parent_path().string();
+      if (inotify_add_watch (inotify_fd_, dir.empty() ? "." : dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        ROS_WARN_STREAM ("Cannot watch " << file_ << ", changes will not be reloaded");
+        close (inotify_fd_);
+        inotify_fd_ = -1;
+        return;
+      }
+      check_timer_ = nh.createTimer (Duration (1, 0), &Fbm2Waypoints::check, this);
+    }
+
+    ~Fbm2Waypoints()
+    {
+      check_timer_.stop();
+      if (inotify_fd_ >= 0) {
+        close (inotify_fd_);
+      }
+    }
+
+    // Empty when no valid configuration was loaded
+    std::shared_ptr<const Fbm2Config>
+    get() const
+    {
+      return config_;
+    }
+};
+
+#endif
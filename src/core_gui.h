@@ -25,6 +25,10 @@
 #include "core_shared_state.h"
 #include "core_public_channel.h"
 #include "core_zone_manager.h"
+#include "core_publisher.h"
+#include "zone_topics.h"
+
+#include <roah_rsbb/CoreSummary.h>
 
 
 
@@ -35,9 +39,32 @@ class CoreGui
     CorePublicChannel& public_channel_;
     CoreZoneManager& zone_manager_;
 
-    Publisher pub_;
+    // Everything in one message, for clients that want all zones
+    ReusedPublisher<roah_rsbb::CoreToGui> pub_;
+    ReusedPublisher<roah_rsbb::CoreSummary> summary_pub_;
     Timer pub_timer_;
 
+    // Per zone topics, filled only while someone subscribes to them
+    struct ZoneTopics {
+      ReusedPublisher<roah_rsbb::ZoneState> state;
+      ReusedPublisher<roah_rsbb::ZoneLog> log;
+      ReusedPublisher<roah_rsbb::ZoneLog> online_data;
+      // Newest entry sent on each log, to send them only on change
+      uint64_t log_seq;
+      uint64_t online_data_seq;
+
+      ZoneTopics (NodeHandle& nh,
+                  string const& zone)
+        : state (nh, zone_topic (zone, "state"), true)
+        , log (nh, zone_topic (zone, "log"), true)
+        , online_data (nh, zone_topic (zone, "online_data"), true)
+        , log_seq (0)
+        , online_data_seq (0)
+      {
+      }
+    };
+    map<string, unique_ptr<ZoneTopics>> zone_topics_;
+
     ServiceServer set_score_srv_;
     ServiceServer manual_operation_complete_srv_;
     ServiceServer omf_complete_srv_;
@@ -50,6 +77,115 @@ class CoreGui
     ServiceServer previous_srv_;
     ServiceServer next_srv_;
 
+    template<typename M>
+    void
+    fill_tablet (M& msg)
+    {
+      msg.tablet_last_beacon = ss_.last_tablet_time;
+      msg.tablet_display_map = ss_.tablet_display_map;
+      if (ss_.last_tablet) {
+        msg.tablet_call_time = roah_rsbb::proto_to_ros_time (ss_.last_tablet->last_call());
+        msg.tablet_position_time = roah_rsbb::proto_to_ros_time (ss_.last_tablet->last_pos());
+        msg.tablet_position_x = ss_.last_tablet->x();
+        msg.tablet_position_y = ss_.last_tablet->y();
+      }
+      else {
+        msg.tablet_call_time = TIME_MIN;
+        msg.tablet_position_time = TIME_MIN;
+        msg.tablet_position_x = 0;
+        msg.tablet_position_y = 0;
+      }
+    }
+
+    void
+    transmit_summary (Time const& now)
+    {
+      roah_rsbb::CoreSummary& msg = summary_pub_.begin();
+      msg.clock = now;
+      msg.status.assign (ss_.status);
+      msg.status.append ("\n").append (ss_.timers.stats_str());
+      msg.status.append ("\n").append (public_channel_.stats_str());
+      msg.status.append ("\nAllocations handling ").append (ss_.robot_state_allocations.str());
+      msg.status.append ("\nCoreSummary: ").append (summary_pub_.stats_str());
+      msg.addr.assign (public_channel_.host());
+      msg.port.assign (to_string (public_channel_.port()));
+      ss_.active_robots.msg (msg.active_robots);
+
+      size_t n = 0;
+      for (auto const& i : zone_manager_.zones()) {
+        if (i.second) {
+          set_element (msg.zones, n++, i.first);
+        }
+      }
+      msg.zones.resize (n);
+
+      fill_tablet (msg);
+
+      summary_pub_.publish();
+    }
+
+    // Publishes the log when it has new entries, subscribers get the last
+    // one from the latch
+    void
+    transmit_log (ReusedPublisher<roah_rsbb::ZoneLog>& pub,
+                  uint64_t& seq,
+                  LogRing const* ring)
+    {
+      uint64_t last = ring ? ring->last_seq() : 0;
+      if (last == seq) {
+        return;
+      }
+      seq = last;
+
+      roah_rsbb::ZoneLog& msg = pub.begin();
+      if (ring) {
+        ring->fill (msg);
+      }
+      else {
+        msg.topics.clear();
+        msg.entries.clear();
+      }
+      pub.publish();
+    }
+
+    void
+    transmit_zones (Time const& now)
+    {
+      map<string, Zone::Ptr> const& zones = zone_manager_.zones();
+
+      // Zones come and go on reload
+      for (auto i = zone_topics_.begin(); i != zone_topics_.end();) {
+        auto z = zones.find (i->first);
+        if ( (z == zones.end()) || (! z->second)) {
+          i = zone_topics_.erase (i);
+        }
+        else {
+          ++i;
+        }
+      }
+
+      for (auto const& i : zones) {
+        if (! i.second) {
+          continue;
+        }
+        unique_ptr<ZoneTopics>& topics = zone_topics_[i.first];
+        if (! topics) {
+          topics.reset (new ZoneTopics (ss_.nh, i.first));
+        }
+
+        if (topics->state.watched()) {
+          i.second->msg (now, topics->state.begin(), false);
+          topics->state.publish();
+        }
+        if (topics->log.watched()) {
+          transmit_log (topics->log, topics->log_seq, i.second->log());
+        }
+        if (topics->online_data.watched()) {
+          transmit_log (topics->online_data, topics->online_data_seq, i.second->online_data());
+        }
+      }
+    }
+
     void
     transmit (const TimerEvent& = TimerEvent())
     {
@@ -57,30 +193,28 @@ class CoreGui
 
       // ROS_DEBUG ("Transmitting CoreToGui message");
 
-      auto msg = boost::make_shared<roah_rsbb::CoreToGui>();
-      msg->clock = now;
-      msg->status = ss_.status;
-      msg->addr = public_channel_.host();
-      msg->port = to_string (public_channel_.port());
-      ss_.active_robots.msg (msg->active_robots);
-      zone_manager_.msg (now, msg->zones);
+      transmit_summary (now);
+      transmit_zones (now);
 
-      msg->tablet_last_beacon = ss_.last_tablet_time;
-      msg->tablet_display_map = ss_.tablet_display_map;
-      if (ss_.last_tablet) {
-        msg->tablet_call_time = roah_rsbb::proto_to_ros_time (ss_.last_tablet->last_call());
-        msg->tablet_position_time = roah_rsbb::proto_to_ros_time (ss_.last_tablet->last_pos());
-        msg->tablet_position_x = ss_.last_tablet->x();
-        msg->tablet_position_y = ss_.last_tablet->y();
-      }
-      else {
-        msg->tablet_call_time = TIME_MIN;
-        msg->tablet_position_time = TIME_MIN;
-        msg->tablet_position_x = 0;
-        msg->tablet_position_y = 0;
+      if (! pub_.watched()) {
+        return;
       }
 
-      pub_.publish (msg);
+      roah_rsbb::CoreToGui& msg = pub_.begin();
+      msg.clock = now;
+      msg.status.assign (ss_.status);
+      msg.status.append ("\n").append (ss_.timers.stats_str());
+      msg.status.append ("\n").append (public_channel_.stats_str());
+      msg.status.append ("\nAllocations handling ").append (ss_.robot_state_allocations.str());
+      msg.status.append ("\nCoreToGui: ").append (pub_.stats_str());
+      msg.addr.assign (public_channel_.host());
+      msg.port.assign (to_string (public_channel_.port()));
+      ss_.active_robots.msg (msg.active_robots);
+      zone_manager_.msg (now, msg.zones);
+
+      fill_tablet (msg);
+
+      pub_.publish();
     }
 
     bool
@@ -233,7 +367,8 @@ class CoreGui
       : ss_ (ss)
       , public_channel_ (public_channel)
       , zone_manager_ (zone_manager)
-      , pub_ (ss_.nh.advertise<roah_rsbb::CoreToGui> ("/core/to_gui", 1, true))
+      , pub_ (ss_.nh, "/core/to_gui", true)
+      , summary_pub_ (ss_.nh, "/core/summary", true)
       , pub_timer_ (ss_.nh.createTimer (Duration (0.1), &CoreGui::transmit, this))
       , set_score_srv_ (ss_.nh.advertiseService ("/core/set_score", &CoreGui::set_score_callback, this))
       , manual_operation_complete_srv_ (ss_.nh.advertiseService ("/core/manual_operation_complete", &CoreGui::manual_operation_complete_callback, this))
@@ -49,8 +49,10 @@
 #include <roah_devices/Percentage.h>
 #include <roah_rsbb/CoreToGui.h>
 #include <roah_rsbb/CoreToPublic.h>
+#include <roah_rsbb/LogEntry.h>
 #include <roah_rsbb/RobotInfo.h>
 #include <roah_rsbb/Zone.h>
+#include <roah_rsbb/ZoneLog.h>
 #include <roah_rsbb/ZoneState.h>
 #include <roah_rsbb/ZoneUInt8.h>
 #include <roah_rsbb/ZoneScore.h>
@@ -22,9 +22,12 @@
 
 #include "core_includes.h"
 
+#include <algorithm>
+
 #include "core_shared_state.h"
 #include "core_public_channel.h"
 #include "core_zone_manager.h"
+#include "core_publisher.h"
 
 
 
@@ -34,43 +37,49 @@ class CorePublic
     CoreSharedState& ss_;
     CoreZoneManager& zone_manager_;
 
-    Publisher pub_;
+    ReusedPublisher<roah_rsbb::CoreToPublic> pub_;
     Timer pub_timer_;
 
     Time relevant_time_;
 
+    // Schedule of all zones and its order, kept across ticks
+    vector<pair<Time, roah_rsbb::ScheduleInfo>> entries_;
+    vector<size_t> order_;
+
     void
     transmit (const TimerEvent& = TimerEvent())
     {
       Time now = Time::now();
 
-      auto msg = boost::make_shared<roah_rsbb::CoreToPublic>();
-      msg->clock = to_string (Time (now.sec, 0));
+      roah_rsbb::CoreToPublic& msg = pub_.begin();
+      msg.clock.assign (to_string (Time (now.sec, 0)));
 
-      multimap<Time, roah_rsbb::ScheduleInfo> map;
-      zone_manager_.msg (now, map);
-      for (auto const& i : map) {
-        if (i.second.running) {
-          relevant_time_ = i.first;
+      zone_manager_.msg (now, entries_);
+      // By time, and in zone order for the same time
+      order_.resize (entries_.size());
+      for (size_t i = 0; i < order_.size(); ++i) {
+        order_[i] = i;
+      }
+      sort (order_.begin(), order_.end(), [this] (size_t a, size_t b) {
+        return (entries_[a].first < entries_[b].first)
+               || ( (entries_[a].first == entries_[b].first) && (a < b));
+      });
+
+      for (size_t i : order_) {
+        if (entries_[i].second.running) {
+          relevant_time_ = entries_[i].first;
           break;
         }
       }
-      {
-        multimap<Time, roah_rsbb::ScheduleInfo>::iterator i = map.begin();
-        while (i != map.end()) {
-          if (i->first < relevant_time_) {
-            i = map.erase (i);
-          }
-          else {
-            break;
-          }
+      size_t n = 0;
+      for (size_t i : order_) {
+        if (! (entries_[i].first < relevant_time_)) {
+          set_element (msg.schedule, n++, entries_[i].second);
         }
       }
-      for (auto const& i : map) {
-        msg->schedule.push_back (i.second);
-      }
+      msg.schedule.resize (n);
 
-      pub_.publish (msg);
+      pub_.publish();
     }
 
   public:
@@ -78,7 +87,7 @@ class CorePublic
                 CoreZoneManager& zone_manager)
       : ss_ (ss)
       , zone_manager_ (zone_manager)
-      , pub_ (ss_.nh.advertise<roah_rsbb::CoreToPublic> ("/core/to_public", 1, true))
+      , pub_ (ss_.nh, "/core/to_public", true)
       , pub_timer_ (ss_.nh.createTimer (Duration (0.5), &CorePublic::transmit, this))
       , relevant_time_ (TIME_MIN)
     {
@@ -23,6 +23,8 @@
 #include "core_includes.h"
 
 #include "core_shared_state.h"
+#include "core_rate_limit.h"
+#include "core_allocations.h"
 
 
 
@@ -32,10 +34,65 @@ class CorePublicChannel
 {
     CoreSharedState& ss_;
 
+    unique_ptr<udp_batch::Membership> group_;
+
     Timer beacon_timer_;
+    bool transmitting_;
+    Time last_sent_;
+
+    // Beacons pushed on device and tablet events, at most one per
+    // push_min_interval_, repeated push_repeats_ times for loss resilience
+    const Duration push_min_interval_;
+    const Duration push_spacing_;
+    const unsigned push_repeats_;
+    unsigned push_left_;
+    TimerWheel::Handle push_timer_;
+    // Earliest event not yet sent, zero if none
+    Time event_time_;
+    uint64_t pushed_events_;
+    double latency_sum_;
+    double latency_max_;
+
+    // Admission control: packets over the rate of their source are
+    // dropped, and robot beacons wait in a bounded intake where a newer
+    // beacon of the same robot replaces the pending one. The intake keeps
+    // its storage, and a decoded beacon is released once processed.
+    struct PendingBeacon {
+      size_t hash;
+      std::shared_ptr<const roah_rsbb_msgs::RobotBeacon> msg;
+      Time received;
+    };
+
+    SourceRateLimiter limiter_;
+    vector<PendingBeacon> intake_;
+    const size_t intake_max_;
+    TimerWheel::Handle intake_timer_;
+
+    uint64_t dropped_rate_;
+    uint64_t dropped_full_;
+    uint64_t coalesced_;
+
+    AllocationCounter robot_beacon_allocations_;
+    AllocationCounter tablet_beacon_allocations_;
 
     void
     transmit_beacon (const TimerEvent& = TimerEvent())
+    {
+      send_beacon (Time::now());
+    }
+
+    void
+    push_tick (Time const& now)
+    {
+      send_beacon (now);
+      if (push_left_ > 0) {
+        --push_left_;
+        push_timer_ = ss_.timers.at (now + push_spacing_, boost::bind (&CorePublicChannel::push_tick, this, _1), "beacon_push");
+      }
+    }
+
+    void
+    send_beacon (Time const& now)
     {
       ROS_DEBUG ("Transmitting beacon");
 
@@ -71,7 +128,17 @@ class CorePublicChannel
         msg.set_tablet_position_y (0);
       }
       send (msg);
+
+      last_sent_ = now;
+      if (! event_time_.isZero()) {
+        double latency = (now - event_time_).toSec();
+        ++pushed_events_;
+        latency_sum_ += latency;
+        latency_max_ = max (latency_max_, latency);
+        event_time_ = Time();
+      }
     }
+
     void
     setup_transmit_beacon (const TimerEvent&)
     {
@@ -79,6 +146,7 @@ class CorePublicChannel
 
       beacon_timer_.stop();
       beacon_timer_ = ss_.nh.createTimer (Duration (1, 0), &CorePublicChannel::transmit_beacon, this);
+      transmitting_ = true;
 
       ss_.status = "OK";
     }
@@ -95,26 +163,64 @@ class CorePublicChannel
       abort_rsbb();
     }
 
+    void
+    process_intake (Time const& now)
+    {
+      AllocationCounter::Scope scope (robot_beacon_allocations_, 0);
+
+      for (PendingBeacon const& i : intake_) {
+        std::shared_ptr<const roah_rsbb_msgs::RobotBeacon> const& msg = i.msg;
+        Time msg_time (msg->time().sec(), msg->time().nsec());
+        roah_rsbb::RobotInfo const& ri = ss_.active_robots.add (msg->team_name(), msg->robot_name(), msg_time, i.received);
+
+        ROS_DEBUG_STREAM ("Processed RobotBeacon"
+                          << ", team_name: " << msg->team_name()
+                          << ", robot_name: " << msg->robot_name()
+                          << ", time: " << msg->time().sec() << "." << msg->time().nsec()
+                          << ", skew: " << ri.skew_last
+                          << ", filtered skew: " << ri.skew);
+      }
+      intake_.clear();
+
+      limiter_.prune (now);
+    }
+
     void
     receive_robot_beacon (boost::asio::ip::udp::endpoint endpoint,
                           uint16_t comp_id,
                           uint16_t msg_type,
                           std::shared_ptr<const roah_rsbb_msgs::RobotBeacon> msg)
     {
+      AllocationCounter::Scope scope (robot_beacon_allocations_);
       Time now = Time::now();
-      Time msg_time (msg->time().sec(), msg->time().nsec());
-      Duration skew = msg_time - now;
+
+      if (! limiter_.admit (endpoint, now)) {
+        ++dropped_rate_;
+        return;
+      }
 
       ROS_DEBUG_STREAM ("Received RobotBeacon from " << endpoint.address().to_string()
                         << ":" << endpoint.port()
                         << ", COMP_ID " << comp_id
-                        << ", MSG_TYPE " << msg_type
-                        << ", team_name: " << msg->team_name()
-                        << ", robot_name: " << msg->robot_name()
-                        << ", time: " << msg->time().sec() << "." << msg->time().nsec()
-                        << ", skew: " << skew);
+                        << ", MSG_TYPE " << msg_type);
 
-      ss_.active_robots.add (msg->team_name(), msg->robot_name(), skew, now);
+      std::hash<string> hasher;
+      size_t hash = hasher (msg->team_name()) * 31 + hasher (msg->robot_name());
+      for (PendingBeacon& i : intake_) {
+        if ( (i.hash == hash)
+             && (i.msg->team_name() == msg->team_name())
+             && (i.msg->robot_name() == msg->robot_name())) {
+          i.msg = msg;
+          i.received = now;
+          ++coalesced_;
+          return;
+        }
+      }
+      if (intake_.size() >= intake_max_) {
+        ++dropped_full_;
+        return;
+      }
+      intake_.push_back (PendingBeacon { hash, msg, now });
     }
 
     void
@@ -123,22 +229,96 @@ class CorePublicChannel
                            uint16_t msg_type,
                            std::shared_ptr<const roah_rsbb_msgs::TabletBeacon> msg)
     {
+      AllocationCounter::Scope scope (tablet_beacon_allocations_);
+      Time now = Time::now();
+
+      if (! limiter_.admit (endpoint, now)) {
+        ++dropped_rate_;
+        return;
+      }
+
       ROS_DEBUG_STREAM ("Received TabletBeacon from " << endpoint.address().to_string()
                         << ":" << endpoint.port()
                         << ", COMP_ID " << comp_id
                         << ", MSG_TYPE " << msg_type);
 
-      ss_.last_tablet_time = Time::now();
+      bool changed = (! ss_.last_tablet)
+                     || (ss_.last_tablet->last_call().sec() != msg->last_call().sec())
+                     || (ss_.last_tablet->last_call().nsec() != msg->last_call().nsec())
+                     || (ss_.last_tablet->last_pos().sec() != msg->last_pos().sec())
+                     || (ss_.last_tablet->last_pos().nsec() != msg->last_pos().nsec())
+                     || (ss_.last_tablet->x() != msg->x())
+                     || (ss_.last_tablet->y() != msg->y());
+
+      ss_.last_tablet_time = now;
       ss_.last_tablet = msg;
+
+      if (changed) {
+        push_beacon (now);
+      }
     }
 
   public:
+    // Sends a beacon now, or as soon as the rate cap allows, followed by
+    // a few repeats. event is when the change was observed.
+    void
+    push_beacon (Time const& event)
+    {
+      if (! transmitting_) {
+        return;
+      }
+
+      if (event_time_.isZero()) {
+        event_time_ = event;
+      }
+      push_left_ = push_repeats_;
+      push_timer_.cancel();
+
+      Time now = Time::now();
+      Time next = last_sent_ + push_min_interval_;
+      if (next <= now) {
+        push_tick (now);
+      }
+      else {
+        push_timer_ = ss_.timers.at (next, boost::bind (&CorePublicChannel::push_tick, this, _1), "beacon_push");
+      }
+    }
+
     CorePublicChannel (CoreSharedState& ss)
       : roah_rsbb::RosPublicChannel (param_direct<string> ("~rsbb_host", "10.255.255.255"),
                                      param_direct<int> ("~rsbb_port", 6666))
       , ss_ (ss)
       , beacon_timer_ (ss_.nh.createTimer (Duration (5, 0), &CorePublicChannel::setup_transmit_beacon, this, true))
+      , transmitting_ (false)
+      , push_min_interval_ (param_direct<double> ("~beacon_push_min_interval", 0.05))
+      , push_spacing_ (param_direct<double> ("~beacon_push_spacing", 0.1))
+      , push_repeats_ (param_direct<int> ("~beacon_push_repeats", 2))
+      , push_left_ (0)
+      , pushed_events_ (0)
+      , latency_sum_ (0)
+      , latency_max_ (0)
+      , limiter_ (param_direct<double> ("~public_rate", 20.0),
+                  param_direct<double> ("~public_burst", 40.0),
+                  param_direct<int> ("~public_max_sources", 1024))
+      , intake_max_ (param_direct<int> ("~public_intake_max", 256))
+      , intake_timer_ (ss_.timers.every (Duration (param_direct<double> ("~public_intake_period", 0.05)),
+                                         boost::bind (&CorePublicChannel::process_intake, this, _1), "beacon_intake"))
+      , dropped_rate_ (0)
+      , dropped_full_ (0)
+      , coalesced_ (0)
+      , robot_beacon_allocations_ ("RobotBeacon")
+      , tablet_beacon_allocations_ ("TabletBeacon")
     {
+      intake_.reserve (intake_max_);
+
+      try {
+        group_ = join_if_multicast (host());
+      }
+      catch (std::exception const& e) {
+        ROS_FATAL_STREAM ("Cannot join the public channel multicast group: " << e.what());
+        abort_rsbb();
+      }
+
       set_rsbb_beacon_callback (&CorePublicChannel::receive_rsbb_beacon, this);
       set_robot_beacon_callback (&CorePublicChannel::receive_robot_beacon, this);
       set_tablet_beacon_callback (&CorePublicChannel::receive_tablet_beacon, this);
@@ -146,6 +326,23 @@ class CorePublicChannel
       ROS_INFO ("Listening only... beacon transmission will start in 5 seconds.");
     }
 
+    string
+    stats_str() const
+    {
+      ostringstream o;
+      o << "Public channel: " << limiter_.sources() << " sources, "
+        << dropped_rate_ << " dropped over rate, "
+        << dropped_full_ << " dropped with full intake, "
+        << coalesced_ << " coalesced";
+      o << "\nAllocations handling " << robot_beacon_allocations_.str()
+        << "; " << tablet_beacon_allocations_.str();
+      if (pushed_events_) {
+        o << "\nBeacon push: " << pushed_events_ << " events, event to wire "
+          << static_cast<int> (latency_sum_ / pushed_events_ * 1000) << "/" << static_cast<int> (latency_max_ * 1000) << " ms";
+      }
+      return o.str();
+    }
+
     ~CorePublicChannel()
     {
       beacon_timer_.stop();
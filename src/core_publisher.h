@@ -0,0 +1,157 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_PUBLISHER_H__
+#define __CORE_PUBLISHER_H__
+
+#include "core_includes.h"
+
+#include "core_allocations.h"
+
+#include <boost/shared_array.hpp>
+
+
+
+/*
+ * Publisher of a message that is refilled in place on every tick. The
+ * message is serialized once into a pooled buffer, and roscpp hands that
+ * buffer to every subscriber. A buffer goes back to the pool when the
+ * transports and the latch release it.
+ */
+template<typename M>
+class ReusedPublisher
+  : boost::noncopyable
+{
+    struct Buffer {
+      boost::shared_array<uint8_t> data;
+      uint32_t size;
+    };
+
+    Publisher pub_;
+    M msg_;
+    vector<Buffer> pool_;
+
+    uint64_t fill_start_;
+    uint64_t fill_allocations_;
+    uint64_t serialize_allocations_;
+    uint64_t publish_allocations_;
+    uint64_t buffer_allocations_;
+    uint32_t bytes_;
+
+    Buffer&
+    buffer (uint32_t size)
+    {
+      Buffer* free = nullptr;
+      for (Buffer& b : pool_) {
+        if (b.data.unique()) {
+          if (b.size >= size) {
+            return b;
+          }
+          free = &b;
+        }
+      }
+
+      if (! free) {
+        pool_.push_back (Buffer());
+        free = &pool_.back();
+      }
+      // Some slack so that a slowly growing message does not reallocate
+      // on every tick
+      free->size = size + size / 2;
+      free->data.reset (new uint8_t[free->size]);
+      ++buffer_allocations_;
+      return *free;
+    }
+
+    static SerializedMessage
+    serialized (SerializedMessage const& m)
+    {
+      return m;
+    }
+
+  public:
+    ReusedPublisher (NodeHandle& nh,
+                     string const& topic,
+                     bool latch)
+      : pub_ (nh.advertise<M> (topic, 1, latch))
+      , fill_start_ (0)
+      , fill_allocations_ (0)
+      , serialize_allocations_ (0)
+      , publish_allocations_ (0)
+      , buffer_allocations_ (0)
+      , bytes_ (0)
+    {
+      pool_.reserve (4);
+    }
+
+    bool
+    watched() const
+    {
+      return pub_.getNumSubscribers() > 0;
+    }
+
+    // Message to refill, call publish() afterwards
+    M&
+    begin()
+    {
+      fill_start_ = thread_allocation_count();
+      return msg_;
+    }
+
+    void
+    publish()
+    {
+      namespace ser = ros::serialization;
+
+      uint64_t serialize_start = thread_allocation_count();
+      fill_allocations_ = serialize_start - fill_start_;
+
+      uint32_t length = ser::serializationLength (msg_) + 4;
+      Buffer& b = buffer (length);
+      ser::OStream s (b.data.get(), length);
+      ser::serialize (s, length - 4);
+      SerializedMessage m (b.data, length);
+      m.message_start = s.getData();
+      ser::serialize (s, msg_);
+
+      uint64_t publish_start = thread_allocation_count();
+      serialize_allocations_ = publish_start - serialize_start;
+
+      SerializedMessage out;
+      pub_.publish (boost::bind (&ReusedPublisher::serialized, boost::cref (m)), out);
+
+      publish_allocations_ = thread_allocation_count() - publish_start;
+      bytes_ = length;
+    }
+
+    // Allocations made by the publishing thread in the last tick
+    string
+    stats_str() const
+    {
+      ostringstream o;
+      o << bytes_ << " bytes, allocations: "
+        << fill_allocations_ << " fill, "
+        << serialize_allocations_ << " serialize, "
+        << publish_allocations_ << " publish, "
+        << buffer_allocations_ << " buffers in total";
+      return o.str();
+    }
+};
+
+#endif
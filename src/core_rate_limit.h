@@ -0,0 +1,127 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_RATE_LIMIT_H__
+#define __CORE_RATE_LIMIT_H__
+
+#include "core_includes.h"
+
+
+
+class TokenBucket
+{
+    double tokens_;
+    Time last_;
+
+  public:
+    TokenBucket (double burst,
+                 Time const& now)
+      : tokens_ (burst)
+      , last_ (now)
+    {
+    }
+
+    // Takes one token if available
+    bool
+    take (Time const& now,
+          double rate,
+          double burst)
+    {
+      if (now > last_) {
+        tokens_ = min (burst, tokens_ + (now - last_).toSec() * rate);
+        last_ = now;
+      }
+      if (tokens_ < 1) {
+        return false;
+      }
+      tokens_ -= 1;
+      return true;
+    }
+
+    Time const&
+    last() const
+    {
+      return last_;
+    }
+};
+
+
+
+/*
+ * Token bucket per source endpoint. Sources idle for a while are
+ * forgotten, and packets from new sources are refused while the table
+ * is full.
+ */
+class SourceRateLimiter
+  : boost::noncopyable
+{
+    typedef boost::asio::ip::udp::endpoint Endpoint;
+
+    const double rate_;
+    const double burst_;
+    const size_t max_sources_;
+    map<Endpoint, TokenBucket> buckets_;
+
+  public:
+    SourceRateLimiter (double rate,
+                       double burst,
+                       size_t max_sources)
+      : rate_ (rate)
+      , burst_ (burst)
+      , max_sources_ (max_sources)
+    {
+    }
+
+    bool
+    admit (Endpoint const& source,
+           Time const& now)
+    {
+      auto b = buckets_.find (source);
+      if (b == buckets_.end()) {
+        if (buckets_.size() >= max_sources_) {
+          return false;
+        }
+        b = buckets_.insert (make_pair (source, TokenBucket (burst_, now))).first;
+      }
+      return b->second.take (now, rate_, burst_);
+    }
+
+    // Forgets the sources with a full bucket
+    void
+    prune (Time const& now)
+    {
+      Duration refill (burst_ / rate_);
+      for (auto b = buckets_.begin(); b != buckets_.end();) {
+        if ( (b->second.last() + refill) < now) {
+          b = buckets_.erase (b);
+        }
+        else {
+          ++b;
+        }
+      }
+    }
+
+    size_t
+    sources() const
+    {
+      return buckets_.size();
+    }
+};
+
+#endif
@@ -23,6 +23,12 @@
 #include "core_includes.h"
 
 #include "core_aux.h"
+#include "core_allocations.h"
+#include "core_benchmark_types.h"
+#include "core_clock_skew.h"
+#include "core_fbm2_waypoints.h"
+#include "core_symbol.h"
+#include "core_timer_wheel.h"
 
 
 
@@ -30,70 +36,98 @@ class ActiveRobots
   : boost::noncopyable
 {
     Duration robot_timeout_;
+    Duration skew_window_;
+    size_t skew_max_samples_;
+
+    struct Robot {
+      roah_rsbb::RobotInfo info;
+      ClockSkewEstimator estimator;
+
+      Robot (string const& team,
+             string const& robot,
+             Duration const& window,
+             size_t max_samples)
+        : estimator (window, max_samples)
+      {
+        info.team = team;
+        info.robot = robot;
+      }
+    };
 
-    // sum . map size team_robot_map_ == size last_beacon_map_
-    map<string, map<string, roah_rsbb::RobotInfo::ConstPtr>> team_robot_map_;
-    map<Time, roah_rsbb::RobotInfo::ConstPtr> last_beacon_map_;
+    // Updated in place on every message, so that only a new robot allocates
+    map<string, map<string, Robot>> team_robot_map_;
 
     void
     update ()
     {
       auto now = Time::now();
 
-      while ( (! last_beacon_map_.empty())
-              && ( (last_beacon_map_.begin()->first + robot_timeout_) < now)) {
-        team_robot_map_[last_beacon_map_.begin()->second->team].erase (last_beacon_map_.begin()->second->robot);
-        last_beacon_map_.erase (last_beacon_map_.begin());
+      for (auto team = team_robot_map_.begin(); team != team_robot_map_.end();) {
+        for (auto i = team->second.begin(); i != team->second.end();) {
+          if ( (i->second.info.beacon + robot_timeout_) < now) {
+            i = team->second.erase (i);
+          }
+          else {
+            ++i;
+          }
+        }
+        if (team->second.empty()) {
+          team = team_robot_map_.erase (team);
+        }
+        else {
+          ++team;
+        }
       }
     }
 
   public:
     ActiveRobots()
       : robot_timeout_ (param_direct<double> ("~robot_timeout", 30.0))
+      , skew_window_ (param_direct<double> ("~skew_window", 10.0))
+      , skew_max_samples_ (param_direct<int> ("~skew_max_samples", 64))
     {
     }
 
-    void
-    add (roah_rsbb::RobotInfo::ConstPtr const& ri)
-    {
-      auto last_team = team_robot_map_.find (ri->team);
-      if (last_team != team_robot_map_.end()) {
-        auto last = last_team->second.find (ri->robot);
-        if (last != last_team->second.end()) {
-          last_beacon_map_.erase (last->second->beacon);
-          last_beacon_map_[ri->beacon] = ri;
-          last->second = ri;
-          return;
-        }
-      }
-      team_robot_map_[ri->team][ri->robot] = ri;
-      last_beacon_map_[ri->beacon] = ri;
-    }
-
-    void
+    // Adds a message sent by the robot at robot_time and received at
+    // beacon. The result is valid until the robot times out.
+    roah_rsbb::RobotInfo const&
     add (string const& team,
          string const& robot,
-         Duration const& skew,
+         Time const& robot_time,
          Time const& beacon)
     {
-      auto msg = boost::make_shared<roah_rsbb::RobotInfo>();
-      msg->team = team;
-      msg->robot = robot;
-      msg->skew = skew;
-      msg->beacon = beacon;
-      add (msg);
+      map<string, Robot>& robots = team_robot_map_[team];
+      auto i = robots.find (robot);
+      if (i == robots.end()) {
+        i = robots.insert (make_pair (robot, Robot (team, robot, skew_window_, skew_max_samples_))).first;
+      }
+
+      ClockSkewEstimator& estimator = i->second.estimator;
+      estimator.add (robot_time, beacon);
+
+      roah_rsbb::RobotInfo& info = i->second.info;
+      info.skew = estimator.skew();
+      info.skew_last = estimator.last();
+      info.delay_median = estimator.delay_median();
+      info.delay_p95 = estimator.delay_p95();
+      info.skew_samples = estimator.samples();
+      info.beacon = beacon;
+      return info;
     }
 
+    // Refills msg in place
     void
     msg (vector<roah_rsbb::RobotInfo>& msg)
     {
       update();
 
+      size_t n = 0;
       for (auto const& iteam : team_robot_map_) {
         for (auto const& i : iteam.second) {
-          msg.push_back (* (i.second));
+          set_element (msg, n++, i.second.info);
         }
       }
+      msg.resize (n);
     }
 
     vector<roah_rsbb::RobotInfo>
@@ -105,11 +139,7 @@ class ActiveRobots
       ret.reserve (team_robot_map_.size());
 
       for (auto const& iteam : team_robot_map_) {
-        map<string, roah_rsbb::RobotInfo::ConstPtr> rm = iteam.second;
-
-        if (! rm.empty()) {
-          ret.push_back (* (rm.begin()->second));
-        }
+        ret.push_back (iteam.second.begin()->second.info);
       }
 
       return ret;
@@ -120,13 +150,12 @@ class ActiveRobots
     {
       update();
 
-      map<string, roah_rsbb::RobotInfo::ConstPtr> rm = team_robot_map_[team];
-
-      if (rm.empty()) {
+      auto iteam = team_robot_map_.find (team);
+      if (iteam == team_robot_map_.end()) {
         return roah_rsbb::RobotInfo();
       }
 
-      return * (rm.begin()->second);
+      return iteam->second.begin()->second.info;
     }
 };
 
@@ -138,19 +167,16 @@ struct ScoringItem {
   string group;
   string desc;
   scoring_type_t type;
-  int32_t current_value;
 
   ScoringItem (string const& benchmark,
                string const& group_name,
                YAML::Node const& item_node)
     : group (group_name)
-    , current_value (0)
   {
     using namespace YAML;
 
     if (! item_node["type"]) {
-      ROS_FATAL_STREAM ("Benchmark \"" << benchmark << "\" scoring item in \"" << group_name << "\" is missing a \"type\" entry! :\n" << item_node);
-      abort_rsbb();
+      throw ConfigError ("Benchmark \"" + benchmark + "\" scoring item in \"" + group_name + "\" is missing a \"type\" entry! :\n" + YAML::Dump (item_node));
     }
     string type_s = item_node["type"].as<string>();
     if (type_s == "bool") {
@@ -160,67 +186,79 @@ struct ScoringItem {
       type = SCORING_UINT;
     }
     else {
-      ROS_FATAL_STREAM ("Benchmark \"" << benchmark << "\" scoring item in \"" << group_name << "\" type is unknown:" << type_s);
-      abort_rsbb();
+      throw ConfigError ("Benchmark \"" + benchmark + "\" scoring item in \"" + group_name + "\" type is unknown:" + type_s);
     }
 
     if (! item_node["desc"]) {
-      ROS_FATAL_STREAM ("Benchmark \"" << benchmark << "\" scoring item in \"" << group_name << "\" is missing a \"desc\" entry! :\n" << item_node);
-      abort_rsbb();
+      throw ConfigError ("Benchmark \"" + benchmark + "\" scoring item in \"" + group_name + "\" is missing a \"desc\" entry! :\n" + YAML::Dump (item_node));
     }
     desc = item_node["desc"].as<string>();
   }
+
+  bool
+  operator== (ScoringItem const& other) const
+  {
+    return (group == other.group) && (desc == other.desc) && (type == other.type);
+  }
 };
 
 
 
+/*
+ * Benchmark definition, shared by every event of the schedule that runs
+ * it. Scores of each run are kept by the executor, in scoring order.
+ */
 struct Benchmark {
   string name;
   string desc;
-  string code;
+  Symbol code;
   Duration timeout;
   Duration total_timeout;
   vector<ScoringItem> scoring;
+
+  bool
+  operator== (Benchmark const& other) const
+  {
+    return (name == other.name) && (desc == other.desc) && (code == other.code)
+           && (timeout == other.timeout) && (total_timeout == other.total_timeout)
+           && (scoring == other.scoring);
+  }
 };
 
 
 
 class Benchmarks
 {
-    map<string, Benchmark> by_code_;
+    map<Symbol, std::shared_ptr<const Benchmark>> by_code_;
 
   public:
-    Benchmarks()
+    // Throws ConfigError or YAML::Exception
+    Benchmarks (string const& file_name)
     {
       using namespace YAML;
 
-      Node file = LoadFile (param_direct<string> ("~benchmarks_file", "benchmarks.yaml"));
+      Node file = LoadFile (file_name);
       if (! file.IsSequence()) {
-        ROS_FATAL_STREAM ("Benchmarks file is not a sequence!");
-        abort_rsbb();
+        throw ConfigError ("Benchmarks file is not a sequence!");
       }
       for (Node const& benchmark_node : file) {
         if (! benchmark_node.IsMap()) {
-          ROS_FATAL_STREAM ("Benchmarks file has a benchmark entry that is not a map!");
-          abort_rsbb();
+          throw ConfigError ("Benchmarks file has a benchmark entry that is not a map!");
         }
         if (! benchmark_node["name"]) {
-          ROS_FATAL_STREAM ("Benchmarks file is missing a \"node\" entry!");
-          abort_rsbb();
+          throw ConfigError ("Benchmarks file is missing a \"node\" entry!");
         }
         if (! benchmark_node["desc"]) {
-          ROS_FATAL_STREAM ("Benchmarks file is missing a \"desc\" entry!");
-          abort_rsbb();
+          throw ConfigError ("Benchmarks file is missing a \"desc\" entry!");
         }
         if (! benchmark_node["code"]) {
-          ROS_FATAL_STREAM ("Benchmarks file is missing a \"code\" entry!");
-          abort_rsbb();
+          throw ConfigError ("Benchmarks file is missing a \"code\" entry!");
         }
         if (! benchmark_node["timeout"]) {
-          ROS_FATAL_STREAM ("Benchmarks file is missing a \"timeout\" entry!");
-          abort_rsbb();
+          throw ConfigError ("Benchmarks file is missing a \"timeout\" entry!");
         }
-        Benchmark b;
+        auto bp = make_shared<Benchmark>();
+        Benchmark& b = *bp;
         b.name = benchmark_node["name"].as<string>();
         b.desc = benchmark_node["desc"].as<string>();
         b.code = benchmark_node["code"].as<string>();
@@ -234,19 +272,16 @@ class Benchmarks
 
         if (benchmark_node["scoring"]) {
           if (! benchmark_node["scoring"].IsSequence()) {
-            ROS_FATAL_STREAM ("Benchmark \"" << b.name << "\" \"scoring\" entry is not a sequence! :\n" << benchmark_node["scoring"]);
-            abort_rsbb();
+            throw ConfigError ("Benchmark \"" + b.name + "\" \"scoring\" entry is not a sequence! :\n" + Dump (benchmark_node["scoring"]));
           }
           for (Node const& scoring_node : benchmark_node["scoring"]) {
             if (! scoring_node.IsMap()) {
-              ROS_FATAL_STREAM ("Benchmark \"" << b.name << "\" \"scoring\" entry is not a sequence of maps! :\n" << scoring_node);
-              abort_rsbb();
+              throw ConfigError ("Benchmark \"" + b.name + "\" \"scoring\" entry is not a sequence of maps! :\n" + Dump (scoring_node));
             }
             for (YAML::const_iterator it = scoring_node.begin(); it != scoring_node.end(); ++it) {
               string group_name = it->first.as<string>();
               if (! it->second.IsSequence()) {
-                ROS_FATAL_STREAM ("Benchmark \"" << b.name << "\" scoring \"" << it->first << "\" is not a sequence! :\n" << it->second);
-                abort_rsbb();
+                throw ConfigError ("Benchmark \"" + b.name + "\" scoring \"" + group_name + "\" is not a sequence! :\n" + Dump (it->second));
               }
               for (Node const& item_node : it->second) {
                 b.scoring.push_back (ScoringItem (b.name, group_name, item_node));
@@ -254,20 +289,38 @@ class Benchmarks
             }
           }
         }
-        by_code_[b.code] = b;
+        by_code_[b.code] = bp;
       }
     }
 
-    Benchmark const&
-    get (string const& code) const
+    // Throws ConfigError if there is no benchmark with this code
+    std::shared_ptr<const Benchmark> const&
+    get (Symbol const& code) const
     {
       auto b = by_code_.find (code);
       if (b == by_code_.end()) {
-        ROS_FATAL_STREAM ("Could not find benchmark with code \"" << code << "\"");
-        abort_rsbb();
+        throw ConfigError ("Could not find benchmark with code \"" + code.str() + "\"");
       }
       return b->second;
     }
+
+    // Reuses the definitions that did not change, so that events using
+    // them compare equal; returns the codes that were added or changed
+    vector<Symbol>
+    share_unchanged (Benchmarks const& previous)
+    {
+      vector<Symbol> changed;
+      for (auto& i : by_code_) {
+        auto p = previous.by_code_.find (i.first);
+        if ( (p != previous.by_code_.end()) && (*p->second == *i.second)) {
+          i.second = p->second;
+        }
+        else {
+          changed.push_back (i.first);
+        }
+      }
+      return changed;
+    }
 };
 
 
@@ -277,30 +330,42 @@ class Passwords
     map<string, string> passwords_;
 
   public:
-    Passwords()
+    // Throws ConfigError or YAML::Exception
+    Passwords (string const& file_name)
     {
       using namespace YAML;
 
-      Node file = LoadFile (param_direct<string> ("~passwords_file", "passwords.yaml"));
+      Node file = LoadFile (file_name);
       if (! file.IsMap()) {
-        ROS_FATAL_STREAM ("Passwords file is not a map!");
-        abort_rsbb();
+        throw ConfigError ("Passwords file is not a map!");
       }
       for (auto const& team_node : file) {
         passwords_[team_node.first.as<string>()] = team_node.second.as<string>();
       }
     }
 
+    bool
+    has (string const& team) const
+    {
+      return passwords_.count (team) != 0;
+    }
+
+    // Throws ConfigError if the team has no password
     string const&
     get (string const& team) const
     {
       auto b = passwords_.find (team);
       if (b == passwords_.end()) {
-        ROS_FATAL_STREAM ("Could not find password for team \"" << team << "\"");
-        abort_rsbb();
+        throw ConfigError ("Could not find password for team \"" + team + "\"");
       }
       return b->second;
     }
+
+    bool
+    operator== (Passwords const& other) const
+    {
+      return passwords_ == other.passwords_;
+    }
 };
 
 
@@ -308,26 +373,36 @@ class Passwords
 struct CoreSharedState
     : boost::noncopyable {
   NodeHandle nh;
+  TimerWheel timers;
   ActiveRobots active_robots;
   string status;
-  const Benchmarks benchmarks;
-  const Passwords passwords;
+  BenchmarkTypes benchmark_types;
+  // Replaced on reload
+  Benchmarks benchmarks;
+  Passwords passwords;
+  Fbm2Waypoints fbm2_waypoints;
   const string run_uuid;
   map<string, pair<string, uint32_t>> benchmarking_robots;
   bool tablet_display_map;
   roah_devices::DevicesState::ConstPtr last_devices_state;
   Time last_tablet_time;
   std::shared_ptr<const roah_rsbb_msgs::TabletBeacon> last_tablet;
+  AllocationCounter robot_state_allocations;
 
   unsigned short private_port_;
 
   CoreSharedState()
-    : status ("Initializing...")
+    : timers (nh)
+    , status ("Initializing...")
+    , benchmarks (load_config<Benchmarks> (param_direct<string> ("~benchmarks_file", "benchmarks.yaml")))
+    , passwords (load_config<Passwords> (param_direct<string> ("~passwords_file", "passwords.yaml")))
+    , fbm2_waypoints (nh)
     , run_uuid (to_string (boost::uuids::random_generator() ()))
     , tablet_display_map (false)
     , last_devices_state (boost::make_shared<roah_devices::DevicesState>())
     , last_tablet_time (TIME_MIN)
     , last_tablet (/*empty*/)
+    , robot_state_allocations ("RobotState")
     , private_port_ (param_direct<int> ("~rsbb_port", 6666))
   {
   }
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_SYMBOL_H__
+#define __CORE_SYMBOL_H__
+
+#include "core_includes.h"
+
+#include <mutex>
+#include <unordered_set>
+
+
+
+/*
+ * Interned string, for team, robot and benchmark names. Equal strings
+ * share one copy in a core-wide table that lives until exit, so a symbol
+ * is a single pointer to copy and compare. Interning is thread safe, as
+ * the configuration is parsed off the ROS thread on reload.
+ */
+class Symbol
+{
+    string const* str_;
+
+    static string const*
+    intern (string const& s)
+    {
+      static std::mutex mutex;
+      static unordered_set<string> table;
+      std::lock_guard<std::mutex> lock (mutex);
+      return & (* (table.insert (s).first));
+    }
+
+  public:
+    Symbol()
+      : str_ (intern (string()))
+    {
+    }
+
+    Symbol (string const& s)
+      : str_ (intern (s))
+    {
+    }
+
+    Symbol (const char* s)
+      : str_ (intern (s))
+    {
+    }
+
+    string const&
+    str() const
+    {
+      return *str_;
+    }
+
+    operator string const& () const
+    {
+      return *str_;
+    }
+
+    bool
+    empty() const
+    {
+      return str_->empty();
+    }
+
+    bool
+    operator== (Symbol const& other) const
+    {
+      return str_ == other.str_;
+    }
+
+    bool
+    operator!= (Symbol const& other) const
+    {
+      return str_ != other.str_;
+    }
+
+    bool
+    operator== (const char* other) const
+    {
+      return *str_ == other;
+    }
+
+    bool
+    operator!= (const char* other) const
+    {
+      return *str_ != other;
+    }
+
+    bool
+    operator< (Symbol const& other) const
+    {
+      return (str_ != other.str_) && (*str_ < *other.str_);
+    }
+};
+
+inline ostream&
+operator<< (ostream& os,
+            Symbol const& s)
+{
+  return os << s.str();
+}
+
+#endif
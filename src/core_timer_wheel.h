@@ -0,0 +1,444 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_TIMER_WHEEL_H__
+#define __CORE_TIMER_WHEEL_H__
+
+#include "core_includes.h"
+
+#include <cmath>
+
+
+
+/*
+ * Hierarchical timer wheel driving all benchmark timers from a single
+ * ROS timer.
+ *
+ * There are 4 levels of 64 slots, each level 64 times coarser than the
+ * one below, and entries cascade down as their deadline approaches.
+ * Entries live in a pool and are linked into their slot, so arming and
+ * cancelling are O(1). Deadlines are rounded up to the next tick.
+ *
+ * Callbacks run on the ROS thread, like the ROS timers they replace, and
+ * may arm or cancel any timer.
+ */
+class TimerWheel
+  : boost::noncopyable
+{
+  public:
+    typedef function<void (Time const&) > Callback;
+
+    class Handle
+    {
+        TimerWheel* wheel_;
+        uint32_t id_;
+        uint32_t gen_;
+
+        friend class TimerWheel;
+
+        Handle (TimerWheel* wheel,
+                uint32_t id,
+                uint32_t gen)
+          : wheel_ (wheel)
+          , id_ (id)
+          , gen_ (gen)
+        {
+        }
+
+      public:
+        Handle()
+          : wheel_ (nullptr)
+          , id_ (0)
+          , gen_ (0)
+        {
+        }
+
+        Handle (Handle&& other)
+          : wheel_ (other.wheel_)
+          , id_ (other.id_)
+          , gen_ (other.gen_)
+        {
+          other.wheel_ = nullptr;
+        }
+
+        Handle&
+        operator= (Handle&& other)
+        {
+          if (this != &other) {
+            cancel();
+            wheel_ = other.wheel_;
+            id_ = other.id_;
+            gen_ = other.gen_;
+            other.wheel_ = nullptr;
+          }
+          return *this;
+        }
+
+        Handle (Handle const&) = delete;
+        Handle& operator= (Handle const&) = delete;
+
+        ~Handle()
+        {
+          cancel();
+        }
+
+        void
+        cancel()
+        {
+          if (wheel_) {
+            wheel_->cancel (id_, gen_);
+            wheel_ = nullptr;
+          }
+        }
+
+        bool
+        active() const
+        {
+          return wheel_ && wheel_->active (id_, gen_);
+        }
+    };
+
+    struct Stats {
+      uint64_t fired;
+      double sum_late;
+      double max_late;
+
+      Stats()
+        : fired (0)
+        , sum_late (0)
+        , max_late (0)
+      {
+      }
+
+      double
+      mean_late() const
+      {
+        return fired ? (sum_late / fired) : 0;
+      }
+    };
+
+  private:
+    static const unsigned LEVELS = 4;
+    static const unsigned SLOT_BITS = 6;
+    static const unsigned SLOTS = 1 << SLOT_BITS;
+    static const int32_t NONE = -1;
+    static const int32_t FIRING = -2;
+
+    struct Entry {
+      uint64_t tick;
+      Time deadline;
+      Duration period;
+      Callback callback;
+      unsigned stats;
+      uint32_t gen;
+      int32_t prev;
+      int32_t next;
+      int32_t slot;
+    };
+
+    const Duration tick_;
+    const double tick_sec_;
+    Time origin_;
+    // Next tick to process
+    uint64_t current_;
+
+    vector<Entry> entries_;
+    vector<int32_t> free_;
+    int32_t slots_[LEVELS * SLOTS];
+    size_t armed_;
+    vector<pair<int32_t, uint32_t>> firing_;
+
+    map<string, unsigned> stats_index_;
+    vector<pair<string, Stats>> stats_;
+
+    Timer timer_;
+
+    uint64_t
+    to_tick (Time const& t) const
+    {
+      if (t <= origin_) {
+        return 0;
+      }
+      return static_cast<uint64_t> (ceil ( (t - origin_).toSec() / tick_sec_ - 1e-9));
+    }
+
+    void
+    link (int32_t id)
+    {
+      Entry& e = entries_[id];
+      uint64_t tick = max (e.tick, current_);
+      uint64_t delta = tick - current_;
+
+      unsigned level = 0;
+      while ( (level + 1 < LEVELS) && (delta >= (uint64_t (1) << (SLOT_BITS * (level + 1))))) {
+        ++level;
+      }
+      if (delta >= (uint64_t (1) << (SLOT_BITS * LEVELS))) {
+        // Beyond the wheel, parked in the last slot and re-linked when reached
+        tick = current_ + (uint64_t (1) << (SLOT_BITS * LEVELS)) - 1;
+      }
+
+      e.slot = level * SLOTS + ( (tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+      e.prev = NONE;
+      e.next = slots_[e.slot];
+      if (e.next != NONE) {
+        entries_[e.next].prev = id;
+      }
+      slots_[e.slot] = id;
+    }
+
+    void
+    unlink (int32_t id)
+    {
+      Entry& e = entries_[id];
+      if (e.prev != NONE) {
+        entries_[e.prev].next = e.next;
+      }
+      else {
+        slots_[e.slot] = e.next;
+      }
+      if (e.next != NONE) {
+        entries_[e.next].prev = e.prev;
+      }
+      e.slot = NONE;
+    }
+
+    void
+    release (int32_t id)
+    {
+      Entry& e = entries_[id];
+      e.callback = Callback();
+      ++e.gen;
+      free_.push_back (id);
+      --armed_;
+    }
+
+    void
+    cancel (uint32_t id,
+            uint32_t gen)
+    {
+      if (active (id, gen)) {
+        if (entries_[id].slot != FIRING) {
+          unlink (id);
+        }
+        entries_[id].slot = NONE;
+        release (id);
+      }
+    }
+
+    bool
+    active (uint32_t id,
+            uint32_t gen) const
+    {
+      return (id < entries_.size()) && (entries_[id].gen == gen) && (entries_[id].slot != NONE);
+    }
+
+    // Moves every entry of a slot to the levels below
+    void
+    cascade (unsigned level,
+             unsigned index)
+    {
+      int32_t id = slots_[level * SLOTS + index];
+      slots_[level * SLOTS + index] = NONE;
+      while (id != NONE) {
+        int32_t next = entries_[id].next;
+        link (id);
+        id = next;
+      }
+    }
+
+    void
+    run_tick (Time const& now)
+    {
+      unsigned index = current_ & (SLOTS - 1);
+      if (index == 0) {
+        for (unsigned level = 1; level < LEVELS; ++level) {
+          unsigned i = (current_ >> (SLOT_BITS * level)) & (SLOTS - 1);
+          cascade (level, i);
+          if (i != 0) {
+            break;
+          }
+        }
+      }
+
+      // Detach the slot first, so callbacks can arm and cancel any timer
+      vector<pair<int32_t, uint32_t>> firing;
+      firing.swap (firing_);
+      for (int32_t i = slots_[index]; i != NONE; i = entries_[i].next) {
+        entries_[i].slot = FIRING;
+        firing.push_back (make_pair (i, entries_[i].gen));
+      }
+      slots_[index] = NONE;
+      uint64_t fired_tick = current_++;
+
+      for (auto const& f : firing) {
+        int32_t id = f.first;
+        Entry& e = entries_[id];
+        if ( (e.gen != f.second) || (e.slot != FIRING)) {
+          // Cancelled by an earlier callback
+          continue;
+        }
+
+        if (e.tick > fired_tick) {
+          // Parked beyond the wheel
+          link (id);
+          continue;
+        }
+
+        Stats& s = stats_[e.stats].second;
+        double late = max (0.0, (now - e.deadline).toSec());
+        ++s.fired;
+        s.sum_late += late;
+        s.max_late = max (s.max_late, late);
+
+        Callback callback = e.callback;
+        if (e.period > Duration()) {
+          e.deadline = e.deadline + e.period;
+          if (e.deadline <= now) {
+            // Fell behind, do not fire a burst
+            e.deadline = now + e.period;
+          }
+          e.tick = to_tick (e.deadline);
+          link (id);
+        }
+        else {
+          e.slot = NONE;
+          release (id);
+        }
+
+        callback (now);
+      }
+
+      firing.clear();
+      firing_.swap (firing);
+    }
+
+    void
+    tick (const TimerEvent& = TimerEvent())
+    {
+      advance (Time::now());
+    }
+
+    Handle
+    add (Time const& deadline,
+         Duration const& period,
+         Callback const& callback,
+         string const& stats)
+    {
+      int32_t id;
+      if (free_.empty()) {
+        id = entries_.size();
+        entries_.push_back (Entry());
+        entries_.back().gen = 0;
+      }
+      else {
+        id = free_.back();
+        free_.pop_back();
+      }
+
+      auto s = stats_index_.find (stats);
+      if (s == stats_index_.end()) {
+        s = stats_index_.insert (make_pair (stats, stats_.size())).first;
+        stats_.push_back (make_pair (stats, Stats()));
+      }
+
+      Entry& e = entries_[id];
+      e.deadline = deadline;
+      e.tick = to_tick (deadline);
+      e.period = period;
+      e.callback = callback;
+      e.stats = s->second;
+      link (id);
+      ++armed_;
+
+      return Handle (this, id, e.gen);
+    }
+
+  public:
+    TimerWheel (NodeHandle& nh)
+      : tick_ (param_direct<double> ("~timer_wheel_tick", 0.01))
+      , tick_sec_ (tick_.toSec())
+      , origin_ (Time::now())
+      , current_ (0)
+      , armed_ (0)
+      , timer_ (nh.createTimer (tick_, &TimerWheel::tick, this))
+    {
+      fill (slots_, slots_ + LEVELS * SLOTS, NONE);
+    }
+
+    ~TimerWheel()
+    {
+      timer_.stop();
+    }
+
+    // Calls callback once, at deadline
+    Handle
+    at (Time const& deadline,
+        Callback const& callback,
+        string const& stats = "other")
+    {
+      return add (deadline, Duration(), callback, stats);
+    }
+
+    // Calls callback every period, starting one period from now
+    Handle
+    every (Duration const& period,
+           Callback const& callback,
+           string const& stats = "other")
+    {
+      return add (Time::now() + period, period, callback, stats);
+    }
+
+    // Runs all ticks up to now; normally called by the internal ROS timer
+    void
+    advance (Time const& now)
+    {
+      uint64_t target = (now <= origin_) ? 0 : static_cast<uint64_t> ( (now - origin_).toSec() / tick_sec_);
+      while (current_ <= target) {
+        run_tick (now);
+      }
+    }
+
+    size_t
+    armed() const
+    {
+      return armed_;
+    }
+
+    vector<pair<string, Stats>> const&
+    stats() const
+    {
+      return stats_;
+    }
+
+    string
+    stats_str() const
+    {
+      ostringstream o;
+      o << "Timers: " << armed_ << " armed";
+      for (auto const& s : stats_) {
+        if (s.second.fired) {
+          o << "; " << s.first << " late " << static_cast<int> (s.second.mean_late() * 1000) << "/" << static_cast<int> (s.second.max_late * 1000) << " ms";
+        }
+      }
+      return o.str();
+    }
+};
+
+#endif
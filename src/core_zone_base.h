@@ -23,20 +23,23 @@
 #include "core_includes.h"
 
 #include "core_shared_state.h"
+#include "compact_log.h"
+#include "run_index.h"
 
 
 
 struct Event {
-  string benchmark_code;
-  Benchmark benchmark;
-  string team;
-  string password;
+  Symbol benchmark_code;
+  BenchmarkType const* type;
+  std::shared_ptr<const Benchmark> benchmark;
+  Symbol team;
   unsigned round;
   unsigned run;
   Time scheduled_time;
   // Duration interval_time;
 
   Event (YAML::Node const& event_node)
+    : type (nullptr)
   {
     benchmark_code = yamlschedget<string> (event_node, "benchmark");
     team = yamlschedget<string> (event_node, "team");
@@ -45,58 +48,155 @@ struct Event {
     scheduled_time = Time::fromBoost (boost::posix_time::time_from_string (yamlschedget<string> (event_node, "scheduled_time")));
     // interval_time = Duration (yamlschedget<double> (event_node, "interval_time"));
   }
+
+  // Same schedule entry, possibly with a different benchmark definition
+  bool
+  same_entry (Event const& other) const
+  {
+    return (benchmark_code == other.benchmark_code) && (team == other.team)
+           && (round == other.round) && (run == other.run)
+           && (scheduled_time == other.scheduled_time);
+  }
+
+  bool
+  operator== (Event const& other) const
+  {
+    return same_entry (other) && (type == other.type) && (benchmark == other.benchmark);
+  }
 };
 
 
 
-class DisplayText
+/*
+ * Bounded log of entries shown to clients, which format them. Entries
+ * are kept unformatted with their topic as an index, and a full ring
+ * overwrites the oldest entry in place. An entry equal to the last one
+ * is skipped.
+ */
+class LogRing
   : boost::noncopyable
 {
-    ostringstream text_;
-    string last_;
+    vector<string> topics_;
+    vector<roah_rsbb::LogEntry> entries_;
+    size_t head_;
+    size_t count_;
 
-  public:
-    DisplayText()
+    static uint64_t
+    next_seq()
+    {
+      static uint64_t seq = 0;
+      return ++seq;
+    }
+
+    uint16_t
+    topic_id (string const& topic)
     {
+      for (size_t i = 0; i < topics_.size(); ++i) {
+        if (topics_[i] == topic) {
+          return i;
+        }
+      }
+      topics_.push_back (topic);
+      return topics_.size() - 1;
     }
 
     void
     add (Time const& now,
-         string const& msg)
+         string const& topic,
+         uint8_t type,
+         int32_t value,
+         string const& group,
+         string const& text)
     {
-      if (msg == last_) {
-        return;
+      uint16_t id = topic_id (topic);
+
+      if (count_ > 0) {
+        roah_rsbb::LogEntry const& last = entries_[ (head_ + count_ - 1) % entries_.size()];
+        if ( (last.topic == id) && (last.type == type) && (last.value == value)
+             && (last.group == group) && (last.text == text)) {
+          return;
+        }
       }
 
-      last_ = msg;
+      roah_rsbb::LogEntry* e;
+      if (count_ < entries_.size()) {
+        e = &entries_[ (head_ + count_) % entries_.size()];
+        ++count_;
+      }
+      else {
+        e = &entries_[head_];
+        head_ = (head_ + 1) % entries_.size();
+      }
+      e->seq = next_seq();
+      e->stamp = now;
+      e->topic = id;
+      e->type = type;
+      e->value = value;
+      e->group.assign (group);
+      e->text.assign (text);
+    }
 
-      text_ << endl;
-      text_ << " - " << to_string (now);
-      //text_ << endl;
-      text_ << " - ";
-      text_ << msg;
+  public:
+    LogRing (size_t size)
+      : entries_ (max<size_t> (size, 1))
+      , head_ (0)
+      , count_ (0)
+    {
     }
 
     void
-    add (string const& msg)
+    add_empty (Time const& now,
+               string const& topic)
     {
-      add (Time::now(), msg);
+      add (now, topic, roah_rsbb::LogEntry::TYPE_EMPTY, 0, string(), string());
     }
 
-    string
-    str()
+    void
+    add_uint8 (Time const& now,
+               string const& topic,
+               uint8_t i)
+    {
+      add (now, topic, roah_rsbb::LogEntry::TYPE_UINT8, i, string(), string());
+    }
+
+    void
+    add_string (Time const& now,
+                string const& topic,
+                string const& s)
+    {
+      add (now, topic, roah_rsbb::LogEntry::TYPE_STRING, 0, string(), s);
+    }
+
+    void
+    add_score (Time const& now,
+               string const& topic,
+               string const& group,
+               string const& desc,
+               int32_t value)
     {
-      return text_.str();
+      add (now, topic, roah_rsbb::LogEntry::TYPE_SCORE, value, group, desc);
     }
 
-    string
-    last (size_t length = 1)
+    // Sequence number of the newest entry, 0 if empty
+    uint64_t
+    last_seq() const
     {
-      string ret = text_.str();
-      if (length >= ret.size()) {
-        return ret;
+      return count_ > 0 ? entries_[ (head_ + count_ - 1) % entries_.size()].seq : 0;
+    }
+
+    // Refills msg in place, oldest entry first
+    void
+    fill (roah_rsbb::ZoneLog& msg) const
+    {
+      for (size_t i = 0; i < topics_.size(); ++i) {
+        set_element (msg.topics, i, topics_[i]);
+      }
+      msg.topics.resize (topics_.size());
+
+      for (size_t i = 0; i < count_; ++i) {
+        set_element (msg.entries, i, entries_[ (head_ + i) % entries_.size()]);
       }
-      return ret.substr (ret.size() - length);
+      msg.entries.resize (count_);
     }
 };
 
@@ -106,30 +206,90 @@ class RsbbLog
   : boost::noncopyable
 {
     rosbag::Bag bag_;
-    DisplayText& display_text_;
+    compact_log::Writer compact_;
+    LogRing& display_;
+
+    string log_dir_;
+    string base_;
+    run_index::RunInfo info_;
+
+    void
+    update_index ()
+    {
+      try {
+        run_index::write_sidecar (base_ + ".yaml", info_);
+        run_index::append (log_dir_, info_);
+      }
+      catch (std::exception const& e) {
+        ROS_ERROR_STREAM ("Could not update run index: " << e.what());
+      }
+    }
 
   public:
-    RsbbLog (string const& team,
+    RsbbLog (string const& benchmark_code,
+             string const& team,
              unsigned round,
              unsigned run,
              string const& uuid,
-             DisplayText& display_text)
-      : display_text_ (display_text)
+             LogRing& display)
+      : display_ (display)
     {
-      string log_dir = param_direct<string> ("~log_dir", ".");
-      system (string ("mkdir -p " + log_dir).c_str());
+      log_dir_ = param_direct<string> ("~log_dir", ".");
+      boost::system::error_code ec;
+      boost::filesystem::create_directories (log_dir_, ec);
+      if (ec) {
+        ROS_ERROR_STREAM ("Could not create log directory " << log_dir_ << ": " << ec.message());
+      }
 
+      Time now = Time::now();
       ostringstream o;
-      o << log_dir << "/online_log_";
-      o << to_string (Time::now());
+      o << "online_log_";
+      o << to_string (now);
       o << "_" << team << "_round" << round << "_run" << run;
-      o << "_" << uuid << ".bag";
-      bag_.open (o.str(), rosbag::bagmode::Write);
+      o << "_" << uuid;
+      base_ = (boost::filesystem::path (log_dir_) / o.str()).string();
+      bag_.open (base_ + ".bag", rosbag::bagmode::Write);
+
+      info_.file = o.str() + ".bag";
+      info_.benchmark = benchmark_code;
+      info_.team = team;
+      info_.round = round;
+      info_.run = run;
+      info_.uuid = uuid;
+      info_.start_time = now.toSec();
+
+      if (param_direct<bool> ("~compact_log", false)) {
+        try {
+          compact_.open (base_ + ".rlog");
+          info_.compact_file = o.str() + ".rlog";
+        }
+        catch (std::exception const& e) {
+          ROS_ERROR_STREAM ("Could not open compact log: " << e.what());
+        }
+      }
+
+      update_index();
+
+      log_string ("/rsbb_log/benchmark", now, benchmark_code);
     }
 
     ~RsbbLog()
     {
       bag_.close();
+      compact_.close();
+
+      info_.end_time = Time::now().toSec();
+      info_.size = 0;
+      boost::system::error_code ec;
+      for (string const& f : {info_.file, info_.compact_file}) {
+        if (! f.empty()) {
+          uintmax_t size = boost::filesystem::file_size (boost::filesystem::path (log_dir_) / f, ec);
+          if (! ec) {
+            info_.size += size;
+          }
+        }
+      }
+      update_index();
     }
 
     void
@@ -138,8 +298,11 @@ class RsbbLog
     {
       std_msgs::Empty msg;
       bag_.write (topic, time, msg);
+      if (compact_.is_open()) {
+        compact_.write_empty (topic, time.toNSec());
+      }
 
-      display_text_.add (time, topic);
+      display_.add_empty (time, topic);
     }
 
     void
@@ -150,8 +313,11 @@ class RsbbLog
       std_msgs::UInt8 msg;
       msg.data = i;
       bag_.write (topic, time, msg);
+      if (compact_.is_open()) {
+        compact_.write_uint8 (topic, time.toNSec(), i);
+      }
 
-      display_text_.add (time, topic + "\n" + to_string (i));
+      display_.add_uint8 (time, topic, i);
     }
 
     void
@@ -162,8 +328,11 @@ class RsbbLog
       std_msgs::String msg;
       msg.data = s;
       bag_.write (topic, time, msg);
+      if (compact_.is_open()) {
+        compact_.write_string (topic, time.toNSec(), s);
+      }
 
-      display_text_.add (time, topic + "\n" + s);
+      display_.add_string (time, topic, s);
     }
 
     void
@@ -172,8 +341,11 @@ class RsbbLog
                roah_rsbb::Score const& msg)
     {
       bag_.write (topic, time, msg);
+      if (compact_.is_open()) {
+        compact_.write_score (topic, time.toNSec(), msg.group, msg.desc, msg.value);
+      }
 
-      display_text_.add (time, topic + "\n" + msg.group + ", " + msg.desc + " -> " + to_string (msg.value));
+      display_.add_score (time, topic, msg.group, msg.desc, msg.value);
     }
 
     void
@@ -200,6 +372,8 @@ class RsbbLog
       log_uint8 ("/rsbb_log/rsbb_state", now, state);
       log_string ("/rsbb_log/rsbb_state_str", now, state_name);
       log_string ("/rsbb_log/rsbb_state_desc", now, desc);
+
+      info_.final_state = state_name + ": " + desc;
     }
 
     void
@@ -220,20 +394,85 @@ class RsbbLog
 
 
 
+/*
+ * Logs the entries of a repeated field that were not in the previous
+ * packet.
+ *
+ * Robots repeat the same entries in every packet, so the whole field is
+ * fingerprinted first and unchanged packets are skipped. Otherwise,
+ * entries are looked up by hash in a flat open addressing table, where
+ * each slot records the last packet that had the entry.
+ */
 class ReceiverRepeated
 {
-    set <string> last_;
+    struct Slot {
+      size_t hash;
+      // 0 when empty
+      uint32_t packet;
+    };
+
+    vector<Slot> slots_;
+    size_t used_;
+    uint32_t packet_;
+    size_t fingerprint_;
+    int size_;
+
     RsbbLog& log_;
     string topic_;
-    DisplayText& display_text_;
+    LogRing& display_;
+
+    Slot&
+    find (size_t hash)
+    {
+      size_t mask = slots_.size() - 1;
+      for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        if ( (slots_[i].packet == 0) || (slots_[i].hash == hash)) {
+          return slots_[i];
+        }
+      }
+    }
+
+    // Keeps only the entries of the previous packet, with room for n more
+    void
+    reserve (size_t n)
+    {
+      if ( (used_ + n) * 2 <= slots_.size()) {
+        return;
+      }
+
+      vector<Slot> old;
+      old.swap (slots_);
+      size_t live = 0;
+      for (Slot const& i : old) {
+        if (i.packet == packet_) {
+          ++live;
+        }
+      }
+      size_t capacity = 16;
+      while (capacity < (live + n) * 4) {
+        capacity *= 2;
+      }
+      slots_.assign (capacity, Slot { 0, 0 });
+      used_ = 0;
+      for (Slot const& i : old) {
+        if (i.packet == packet_) {
+          find (i.hash) = i;
+          ++used_;
+        }
+      }
+    }
 
   public:
     ReceiverRepeated (RsbbLog& log,
                       string const& topic,
-                      DisplayText& display_text)
-      : log_ (log)
+                      LogRing& display)
+      : used_ (0)
+      , packet_ (0)
+      , fingerprint_ (0)
+      , size_ (0)
+      , log_ (log)
       , topic_ (topic)
-      , display_text_ (display_text)
+      , display_ (display)
     {
     }
 
@@ -241,15 +480,35 @@ class ReceiverRepeated
     receive (Time const& now,
              ::google::protobuf::RepeatedPtrField<string> const& field)
     {
-      set<string> this_set;
+      std::hash<string> hasher;
+      size_t fingerprint = 0;
+      for (string const& s : field) {
+        fingerprint = (fingerprint * 0x100000001b3ULL) ^ hasher (s);
+      }
+      if ( (field.size() == size_) && (fingerprint == fingerprint_)) {
+        return;
+      }
+      fingerprint_ = fingerprint;
+      size_ = field.size();
+
+      reserve (field.size());
+      uint32_t previous = packet_++;
       for (string const& s : field) {
-        this_set.insert (s);
-        if (0 == last_.count (s)) {
-          display_text_.add (now, topic_ + "\n" + s);
-          log_.log_string (topic_, now, s);
+        size_t hash = hasher (s);
+        Slot& slot = find (hash);
+        if (slot.packet == 0) {
+          slot.hash = hash;
+          ++used_;
+        }
+        else if (slot.packet >= previous) {
+          // In the previous packet, or repeated in this one
+          slot.packet = packet_;
+          continue;
         }
+        slot.packet = packet_;
+        display_.add_string (now, topic_, s);
+        log_.log_string (topic_, now, s);
       }
-      last_ = move (this_set);
     }
 };
 
@@ -266,17 +525,17 @@ class TimeControl
     bool paused_;
     Time pause_start_;
 
-    Timer timeout_timer_;
+    TimerWheel::Handle timeout_timer_;
     const function<void (void) > timeout_2_;
 
     void
-    timeout (const TimerEvent& timer_event)
+    timeout (Time const& now)
     {
       if (paused_) {
         return;
       }
 
-      if (start_timer (timer_event.current_real)) {
+      if (start_timer (now)) {
         return;
       }
 
@@ -287,9 +546,9 @@ class TimeControl
     start_timer (Time const& now)
     {
       Duration until_timeout = get_until_timeout (now);
-      timeout_timer_.stop();
+      timeout_timer_.cancel();
       if (until_timeout > Duration ()) {
-        timeout_timer_ = ss_.nh.createTimer (until_timeout, &TimeControl::timeout, this, true, true);
+        timeout_timer_ = ss_.timers.at (now + until_timeout, boost::bind (&TimeControl::timeout, this, _1), "benchmark_timeout");
         return true;
       }
       return false;
@@ -310,7 +569,7 @@ class TimeControl
 
     ~TimeControl()
     {
-      timeout_timer_.stop();
+      timeout_timer_.cancel();
     }
 
     void
@@ -339,7 +598,7 @@ class TimeControl
 
       paused_ = true;
       pause_start_ = now;
-      timeout_timer_.stop();
+      timeout_timer_.cancel();
     }
 
     void
@@ -24,6 +24,8 @@
 
 #include "core_shared_state.h"
 #include "core_zone_base.h"
+#include "bmbox_payload.h"
+#include "core_bmbox_handshake.h"
 
 
 
@@ -37,8 +39,8 @@ class ExecutingBenchmark
 
     Event const& event_;
 
-    DisplayText display_log_;
-    DisplayText display_online_data_;
+    LogRing display_log_;
+    LogRing display_online_data_;
 
     roah_rsbb_msgs::BenchmarkState::State state_;
     enum { PHASE_PRE, PHASE_EXEC, PHASE_POST } phase_;
@@ -52,18 +54,29 @@ class ExecutingBenchmark
 
     RsbbLog log_;
 
-    vector<ScoringItem> scoring_;
+    // Current value of each item of the benchmark scoring
+    vector<int32_t> scores_;
+
+    // Called when set_state changes the state, not on description updates
+    virtual void
+    state_changed (Time const& now) {}
 
     void
     set_state (Time const& now,
                roah_rsbb_msgs::BenchmarkState::State const& state,
                string const& desc)
     {
+      bool changed = state != state_;
+
       state_ = state;
       state_desc_ = desc;
       state_time_ = now;
 
       log_.set_state (now, state, desc);
+
+      if (changed) {
+        state_changed (now);
+      }
     }
 
     virtual void
@@ -129,14 +142,14 @@ class ExecutingBenchmark
       : ss_ (ss)
       , timeout_pub_ (ss_.nh.advertise<std_msgs::Empty> ("/timeout", 1, false))
       , event_ (event)
-      , display_log_()
-      , display_online_data_()
+      , display_log_ (param_direct<int> ("~display_log_size", 200))
+      , display_online_data_ (param_direct<int> ("~display_log_size", 200))
       , phase_ (PHASE_PRE)
       , stoped_due_to_timeout_ (false)
-      , time_ (ss, event_.benchmark.timeout, boost::bind (&ExecutingBenchmark::timeout_2, this))
+      , time_ (ss, event_.benchmark->timeout, boost::bind (&ExecutingBenchmark::timeout_2, this))
       , manual_operation_ ("")
-      , log_ (event.team, event.round, event.run, ss.run_uuid, display_log_)
-      , scoring_ (event.benchmark.scoring)
+      , log_ (event.benchmark_code, event.team, event.round, event.run, ss.run_uuid, display_log_)
+      , scores_ (event.benchmark->scoring.size(), 0)
       , end_ (end)
     {
       Time now = Time::now();
@@ -162,9 +175,10 @@ class ExecutingBenchmark
     {
       Time now = Time::now();
 
-      for (ScoringItem& i : scoring_) {
-        if ( (score.group == i.group) && (score.desc == i.desc)) {
-          i.current_value = score.value;
+      vector<ScoringItem> const& scoring = event_.benchmark->scoring;
+      for (size_t i = 0; i < scoring.size(); ++i) {
+        if ( (score.group == scoring[i].group) && (score.desc == scoring[i].desc)) {
+          scores_[i] = score.value;
           log_.log_score ("/rsbb_log/score", now, score);
           return;
         }
@@ -235,7 +249,7 @@ class ExecutingBenchmark
     {
       switch (phase_) {
         case PHASE_PRE:
-          zone.timer = event_.benchmark.timeout;
+          zone.timer = event_.benchmark->timeout;
           break;
         case PHASE_EXEC:
           zone.timer = time_.get_until_timeout (now);
@@ -245,40 +259,70 @@ class ExecutingBenchmark
           break;
       }
 
-      zone.state = state_desc_;
+      zone.state.assign (state_desc_);
 
-      zone.manual_operation = manual_operation_;
+      zone.manual_operation.assign (manual_operation_);
 
       zone.start_enabled = state_ == roah_rsbb_msgs::BenchmarkState_State_STOP;
       zone.stop_enabled = ! zone.start_enabled;
 
-      const size_t log_size = param_direct<int> ("~display_log_size", 3000);
-      zone.log = display_log_.last (log_size);
-      zone.online_data = display_online_data_.last (log_size);
-
-      for (ScoringItem const& i : scoring_) {
-        if (zone.scoring.empty() || (zone.scoring.back().group_name != i.group)) {
-          zone.scoring.push_back (roah_rsbb::ZoneScoreGroup());
-          zone.scoring.back().group_name = i.group;
+      // Groups and items are refilled in place
+      auto truncate = [] (roah_rsbb::ZoneScoreGroup & g, size_t items) {
+        g.types.resize (items);
+        g.descriptions.resize (items);
+        g.current_values.resize (items);
+      };
+      size_t groups = 0;
+      size_t items = 0;
+      vector<ScoringItem> const& scoring = event_.benchmark->scoring;
+      for (size_t s = 0; s < scoring.size(); ++s) {
+        ScoringItem const& i = scoring[s];
+        if ( (groups == 0) || (zone.scoring[groups - 1].group_name != i.group)) {
+          if (groups > 0) {
+            truncate (zone.scoring[groups - 1], items);
+          }
+          if (groups == zone.scoring.size()) {
+            zone.scoring.push_back (roah_rsbb::ZoneScoreGroup());
+          }
+          zone.scoring[groups++].group_name.assign (i.group);
+          items = 0;
         }
+        roah_rsbb::ZoneScoreGroup& group = zone.scoring[groups - 1];
         switch (i.type) {
           case ScoringItem::SCORING_BOOL:
-            zone.scoring.back().types.push_back (roah_rsbb::ZoneScoreGroup::SCORING_BOOL);
+            set_element (group.types, items, static_cast<uint8_t> (roah_rsbb::ZoneScoreGroup::SCORING_BOOL));
             break;
           case ScoringItem::SCORING_UINT:
-            zone.scoring.back().types.push_back (roah_rsbb::ZoneScoreGroup::SCORING_UINT);
+            set_element (group.types, items, static_cast<uint8_t> (roah_rsbb::ZoneScoreGroup::SCORING_UINT));
             break;
           default:
             ROS_FATAL_STREAM ("type in ScoringItem error");
             abort_rsbb();
         }
-        zone.scoring.back().descriptions.push_back (i.desc);
-        zone.scoring.back().current_values.push_back (i.current_value);
+        set_element (group.descriptions, items, i.desc);
+        set_element (group.current_values, items, scores_[s]);
+        ++items;
       }
+      if (groups > 0) {
+        truncate (zone.scoring[groups - 1], items);
+      }
+      zone.scoring.resize (groups);
 
       fill_2 (now, zone);
     }
 
+    LogRing const&
+    log() const
+    {
+      return display_log_;
+    }
+
+    LogRing const&
+    online_data() const
+    {
+      return display_online_data_;
+    }
+
     roah_rsbb_msgs::BenchmarkState::State
     state()
     {
@@ -295,15 +339,34 @@ class ExecutingSingleRobotBenchmark
   : public ExecutingBenchmark
 {
   protected:
-    string robot_name_;
+    Symbol robot_name_;
 
+    // Kept for the whole run, a reload must not change the key in use
+    const string password_;
+    const string cypher_;
     unique_ptr<roah_rsbb::RosPrivateChannel> private_channel_;
+    unique_ptr<udp_batch::Membership> private_group_;
+    unsigned short private_port_;
+    // Robot address once it is known, empty while using private_host()
+    string unicast_host_;
+    TimerWheel::Handle reopen_timer_;
+    const bool unicast_private_;
+    const Duration unicast_fallback_;
 
     roah_rsbb_msgs::Time ack_;
     Duration last_skew_;
     Time last_beacon_;
 
-    Timer state_timer_;
+    // BenchmarkState schedule: a state change is sent on the next tick and
+    // repeated state_burst_ times, burst_spacing_ apart, then the state is
+    // only repeated every state_keepalive_
+    TimerWheel::Handle state_timer_;
+    const unsigned state_burst_;
+    const Duration state_keepalive_;
+    const Duration burst_spacing_min_;
+    const Duration burst_spacing_max_;
+    Duration burst_spacing_;
+    unsigned burst_left_;
 
     uint32_t messages_saved_;
 
@@ -319,10 +382,76 @@ class ExecutingSingleRobotBenchmark
     virtual void
     fill_benchmark_state_2 (roah_rsbb_msgs::BenchmarkState& msg) {}
 
+    void
+    state_changed (Time const& now)
+    {
+      burst_left_ = state_burst_;
+      state_timer_ = ss_.timers.at (now, boost::bind (&ExecutingSingleRobotBenchmark::transmit_state, this, _1), "robot_state_tx");
+    }
+
   private:
+    // A multicast group keeps private traffic away from hosts that only
+    // follow the public channel
+    static string
+    private_host()
+    {
+      return param_direct<string> ("~rsbb_private_host", param_direct<string> ("~rsbb_host", "10.255.255.255"));
+    }
+
+    void
+    connect_private_channel()
+    {
+      private_channel_->set_benchmark_state_callback (&ExecutingSingleRobotBenchmark::receive_benchmark_state, this);
+      private_channel_->set_robot_state_callback (&ExecutingSingleRobotBenchmark::receive_robot_state, this);
+    }
+
+    void
+    disconnect_private_channel()
+    {
+      private_channel_->signal_benchmark_state_received().disconnect_all_slots();
+      private_channel_->signal_robot_state_received().disconnect_all_slots();
+    }
+
+    // Reopens the private channel on the same port, sending to host, or
+    // to private_host() when empty
     void
-    transmit_state (const TimerEvent& = TimerEvent())
+    reopen_private_channel (string const& host)
     {
+      disconnect_private_channel();
+      private_channel_.reset();
+      try {
+        private_channel_.reset (new roah_rsbb::RosPrivateChannel (host.empty() ? private_host() : host,
+                                private_port_,
+                                password_,
+                                cypher_));
+        unicast_host_ = host;
+      }
+      catch (std::exception const& e) {
+        if (host.empty()) {
+          ROS_FATAL_STREAM ("Failed to reopen the private channel for team " << event_.team << ": " << e.what());
+          abort_rsbb();
+        }
+        ROS_ERROR_STREAM ("Failed to reopen the private channel for team " << event_.team << " as unicast: " << e.what());
+        reopen_private_channel ("");
+        return;
+      }
+      connect_private_channel();
+      if (host.empty()) {
+        ROS_INFO_STREAM ("Private channel for team " << event_.team << " back to " << private_host() << ", robot silent");
+      }
+      else {
+        ROS_INFO_STREAM ("Private channel for team " << event_.team << " switched to unicast to " << host);
+      }
+    }
+
+    void
+    transmit_state (Time const& now)
+    {
+      if ( (! unicast_host_.empty())
+           && ( (now - last_beacon_) > unicast_fallback_)) {
+        reopen_private_channel ("");
+      }
+
       ROS_DEBUG ("Transmitting benchmark state");
 
       roah_rsbb_msgs::BenchmarkState msg;
@@ -331,6 +460,13 @@ class ExecutingSingleRobotBenchmark
       (* (msg.mutable_acknowledgement())) = ack_;
       fill_benchmark_state_2 (msg);
       private_channel_->send (msg);
+
+      Duration next = state_keepalive_;
+      if (burst_left_ > 0) {
+        --burst_left_;
+        next = burst_spacing_;
+      }
+      state_timer_ = ss_.timers.at (now + next, boost::bind (&ExecutingSingleRobotBenchmark::transmit_state, this, _1), "robot_state_tx");
     }
 
     void
@@ -351,18 +487,31 @@ class ExecutingSingleRobotBenchmark
                          uint16_t msg_type,
                          std::shared_ptr<const roah_rsbb_msgs::RobotState> msg)
     {
+      AllocationCounter::Scope scope (ss_.robot_state_allocations);
       Time now = last_beacon_ = Time::now();
       Time msg_time (msg->time().sec(), msg->time().nsec());
-      Duration last_skew_ = msg_time - now;
+      roah_rsbb::RobotInfo const& ri = ss_.active_robots.add (event_.team, robot_name_, msg_time, now);
+      last_skew_ = ri.skew;
+      // Repeats follow the delay spread of the robot link, as the robot
+      // does not acknowledge the states it receives
+      burst_spacing_ = min (burst_spacing_max_, max (burst_spacing_min_, ri.delay_p95 * 2));
+
+      // Only the robot has the key, so the sender of an authentic message
+      // is the robot; the channel cannot be replaced from its own callback
+      string robot_host = endpoint.address().to_string();
+      if ( (robot_host != unicast_host_)
+           && unicast_private_
+           && (! reopen_timer_.active())) {
+        reopen_timer_ = ss_.timers.at (now, boost::bind (&ExecutingSingleRobotBenchmark::reopen_private_channel, this, robot_host), "private_reopen");
+      }
 
       ROS_DEBUG_STREAM ("Received RobotState from " << endpoint.address().to_string()
                         << ":" << endpoint.port()
                         << ", COMP_ID " << comp_id
                         << ", MSG_TYPE " << msg_type
                         << ", time: " << msg->time().sec() << "." << msg->time().nsec()
-                        << ", skew: " << last_skew_);
-
-      ss_.active_robots.add (event_.team, robot_name_, last_skew_, now);
+                        << ", skew: " << ri.skew_last
+                        << ", filtered skew: " << last_skew_);
 
       messages_saved_ = msg->messages_saved();
       /* if ( (messages_saved_ == 0) */
@@ -390,11 +539,21 @@ class ExecutingSingleRobotBenchmark
                                    string const& robot_name)
       : ExecutingBenchmark (ss, event, end)
       , robot_name_ (robot_name)
-      , private_channel_ (new roah_rsbb::RosPrivateChannel (param_direct<string> ("~rsbb_host", "10.255.255.255"),
+      , password_ (ss_.passwords.get (event_.team))
+      , cypher_ (param_direct<string> ("~rsbb_cypher", "aes-128-cbc"))
+      , private_channel_ (new roah_rsbb::RosPrivateChannel (private_host(),
                           ss_.private_port(),
-                          event_.password,
-                          param_direct<string> ("~rsbb_cypher", "aes-128-cbc")))
-      , state_timer_ (ss_.nh.createTimer (Duration (0.2), &ExecutingSingleRobotBenchmark::transmit_state, this))
+                          password_,
+                          cypher_))
+      , unicast_private_ (param_direct<bool> ("~unicast_private", true))
+      , unicast_fallback_ (param_direct<double> ("~unicast_fallback", 2.0))
+      , state_timer_ (ss_.timers.at (Time::now(), boost::bind (&ExecutingSingleRobotBenchmark::transmit_state, this, _1), "robot_state_tx"))
+      , state_burst_ (param_direct<int> ("~state_burst", 3))
+      , state_keepalive_ (param_direct<double> ("~state_keepalive", 0.5))
+      , burst_spacing_min_ (param_direct<double> ("~state_burst_spacing_min", 0.02))
+      , burst_spacing_max_ (param_direct<double> ("~state_burst_spacing_max", 0.2))
+      , burst_spacing_ (burst_spacing_max_)
+      , burst_left_ (state_burst_)
       , messages_saved_ (0)
       , rcv_notifications_ (log_, "/notification", display_online_data_)
       , rcv_activation_event_ (log_, "/command", display_online_data_)
@@ -403,17 +562,24 @@ class ExecutingSingleRobotBenchmark
     {
       ack_.set_sec (0);
       ack_.set_nsec (0);
-      private_channel_->set_benchmark_state_callback (&ExecutingSingleRobotBenchmark::receive_benchmark_state, this);
-      private_channel_->set_robot_state_callback (&ExecutingSingleRobotBenchmark::receive_robot_state, this);
-      ss_.benchmarking_robots[event_.team] = make_pair (robot_name_, private_channel_->port());
+      private_port_ = private_channel_->port();
+      connect_private_channel();
+      ss_.benchmarking_robots[event_.team] = make_pair (robot_name_, private_port_);
+
+      try {
+        private_group_ = join_if_multicast (private_host());
+      }
+      catch (std::exception const& e) {
+        ROS_ERROR_STREAM ("Cannot join the private channel multicast group, robot messages will not be received: " << e.what());
+      }
     }
 
     void
     stop_communication()
     {
-      state_timer_.stop();
-      private_channel_->signal_benchmark_state_received().disconnect_all_slots();
-      private_channel_->signal_robot_state_received().disconnect_all_slots();
+      state_timer_.cancel();
+      reopen_timer_.cancel();
+      disconnect_private_channel();
       ss_.benchmarking_robots.erase (event_.team);
     }
 };
@@ -423,6 +589,8 @@ class ExecutingSingleRobotBenchmark
 class ExecutingSimpleBenchmark
   : public ExecutingSingleRobotBenchmark
 {
+    const bool devices_control_;
+
     void
     receive_robot_state_2 (Time const& now,
                            roah_rsbb_msgs::RobotState const& msg)
@@ -456,7 +624,7 @@ class ExecutingSimpleBenchmark
           break;
       }
 
-      if (event_.benchmark_code == "HCFGAC") {
+      if (devices_control_) {
         if (msg.has_devices_switch_1()
             && (msg.devices_switch_1() != ss_.last_devices_state->switch_1)) {
           roah_devices::Bool b;
@@ -507,6 +675,7 @@ class ExecutingSimpleBenchmark
                               boost::function<void() > end,
                               string const& robot_name)
       : ExecutingSingleRobotBenchmark (ss, event, end, robot_name)
+      , devices_control_ (event.type->devices_control)
     {
     }
 
@@ -515,9 +684,13 @@ class ExecutingSimpleBenchmark
             roah_rsbb::ZoneState& zone)
     {
       add_to_sting (zone.state) << "Messages saved: " << messages_saved_;
+      if (! unicast_host_.empty()) {
+        zone.state += "\nPrivate channel unicast to " + unicast_host_;
+      }
 
-      if (last_skew_ > Duration (0.5)) {
-        zone.state += "\nWARNING: Last clock skew above threshold: " + to_string (last_skew_.toSec());
+      Duration allowed_skew = Duration (param_direct<double> ("~allowed_skew", 0.5));
+      if ( (last_skew_ >= allowed_skew) || (last_skew_ <= (-allowed_skew))) {
+        zone.state += "\nWARNING: Clock skew above threshold: " + to_string (last_skew_.toSec());
       }
       if ( (now - last_beacon_) > Duration (5)) {
         zone.state += "\nWARNING: Last robot transmission received " + to_string ( (now - last_beacon_).toSec()) + " seconds ago";
@@ -530,17 +703,16 @@ class ExecutingSimpleBenchmark
 class ExecutingExternallyControlledBenchmark
   : public ExecutingSingleRobotBenchmark
 {
+    const BmBoxProtocol bmbox_;
     bool waiting_for_omf_complete_;
     rockin_benchmarking::RefBoxState::_state_type refbox_state_;
-    string annoying_refbox_payload_;
     rockin_benchmarking::ClientState::_state_type client_state_;
-    string annoying_client_payload_;
 
-    Publisher client_state_pub_;
-    Publisher refbox_state_pub_;
+    BmBoxStatePublisher<rockin_benchmarking::ClientState> client_state_pub_;
+    BmBoxStatePublisher<rockin_benchmarking::RefBoxState> refbox_state_pub_;
     Subscriber bmbox_state_sub_;
     rockin_benchmarking::BmBoxState::ConstPtr last_bmbox_state_;
-    Timer annoying_timer_;
+    TimerWheel::Handle retransmit_timer_;
 
     vector<bool> goal_initial_state_;
     vector<uint32_t> goal_switches_;
@@ -554,12 +726,10 @@ class ExecutingExternallyControlledBenchmark
     Duration total_timeout_;
     bool last_timeout_;
 
-    vector<vector<double> > fbm2_locations_;
+    // Shared, kept for the whole run even if the file is reloaded
+    std::shared_ptr<const Fbm2Config> fbm2_;
     int location_idx_;
-    double fbm2_penalty_time_;
-    double fbm2_timeout_time_;
     int fbm2_num_points_;
-    vector<double> fbm2_starting_pose_;
 
 
     void
@@ -570,11 +740,10 @@ class ExecutingExternallyControlledBenchmark
       if (client_state != client_state_) {
         // ROS_INFO("-------------------Setting Client state to: %d", client_state);
         client_state_ = client_state;
-        annoying_client_payload_ = payload;
         rockin_benchmarking::ClientState msg;
         msg.state = client_state;
         msg.payload = payload;
-        client_state_pub_.publish (msg);
+        client_state_pub_.publish (now, msg);
         log_.log_uint8 ("/rsbb_log/client_state", now, client_state);
         log_.log_string ("/rsbb_log/client_state_payload", now, payload);
       }
@@ -588,30 +757,70 @@ class ExecutingExternallyControlledBenchmark
       if (refbox_state != refbox_state_) {
         // ROS_INFO("-------------------Setting RefBox state to: %d-------------------", refbox_state);
         refbox_state_ = refbox_state;
-        annoying_refbox_payload_ = payload;
         rockin_benchmarking::RefBoxState msg;
         msg.state = refbox_state;
         msg.payload = payload;
-        refbox_state_pub_.publish (msg);
+        refbox_state_pub_.publish (now, msg);
         log_.log_uint8 ("/rsbb_log/refbox_state", now, refbox_state);
         log_.log_string ("/rsbb_log/refbox_state_payload", now, payload);
       }
     }
 
     void
-    annoying_timer (const TimerEvent& = TimerEvent())
+    retransmit_timer (Time const& now)
     {
-      if (client_state_ != rockin_benchmarking::ClientState::START) {
-        rockin_benchmarking::ClientState msg;
-        msg.state = client_state_;
-        msg.payload = annoying_client_payload_;
-        client_state_pub_.publish (msg);
+      client_state_pub_.retransmit (now);
+      refbox_state_pub_.retransmit (now);
+    }
+
+    static bool
+    bmbox_answers_client (rockin_benchmarking::BmBoxState::_state_type bmbox_state,
+                          rockin_benchmarking::ClientState::_state_type client_state)
+    {
+      switch (client_state) {
+        case rockin_benchmarking::ClientState::WAITING_GOAL:
+          return (bmbox_state == rockin_benchmarking::BmBoxState::WAITING_MANUAL_OPERATION)
+                 || (bmbox_state == rockin_benchmarking::BmBoxState::TRANSMITTING_GOAL)
+                 || (bmbox_state == rockin_benchmarking::BmBoxState::WAITING_RESULT);
+        case rockin_benchmarking::ClientState::EXECUTING_GOAL:
+          return bmbox_state == rockin_benchmarking::BmBoxState::WAITING_RESULT;
+        case rockin_benchmarking::ClientState::COMPLETED_GOAL:
+          return (bmbox_state == rockin_benchmarking::BmBoxState::READY)
+                 || (bmbox_state == rockin_benchmarking::BmBoxState::WAITING_MANUAL_OPERATION)
+                 || (bmbox_state == rockin_benchmarking::BmBoxState::TRANSMITTING_GOAL)
+                 || (bmbox_state == rockin_benchmarking::BmBoxState::TRANSMITTING_SCORE);
+        case rockin_benchmarking::ClientState::END:
+          return bmbox_state == rockin_benchmarking::BmBoxState::END;
+        default:
+          // No specific answer expected, any transition shows it was seen
+          return true;
       }
-      if (refbox_state_ != rockin_benchmarking::RefBoxState::START) {
-        rockin_benchmarking::RefBoxState msg;
-        msg.state = refbox_state_;
-        msg.payload = annoying_refbox_payload_;
-        refbox_state_pub_.publish (msg);
+    }
+
+    static bool
+    bmbox_answers_refbox (rockin_benchmarking::BmBoxState::_state_type bmbox_state,
+                          rockin_benchmarking::RefBoxState::_state_type refbox_state)
+    {
+      switch (refbox_state) {
+        case rockin_benchmarking::RefBoxState::READY:
+          return (bmbox_state == rockin_benchmarking::BmBoxState::READY)
+                 || (bmbox_state == rockin_benchmarking::BmBoxState::WAITING_MANUAL_OPERATION)
+                 || (bmbox_state == rockin_benchmarking::BmBoxState::TRANSMITTING_GOAL)
+                 || (bmbox_state == rockin_benchmarking::BmBoxState::WAITING_RESULT)
+                 || (bmbox_state == rockin_benchmarking::BmBoxState::TRANSMITTING_SCORE);
+        case rockin_benchmarking::RefBoxState::EXECUTING_MANUAL_OPERATION:
+          return bmbox_state != rockin_benchmarking::BmBoxState::WAITING_MANUAL_OPERATION;
+        case rockin_benchmarking::RefBoxState::EXECUTING_GOAL:
+          return bmbox_state == rockin_benchmarking::BmBoxState::WAITING_RESULT;
+        case rockin_benchmarking::RefBoxState::RECEIVED_SCORE:
+          return (bmbox_state == rockin_benchmarking::BmBoxState::READY)
+                 || (bmbox_state == rockin_benchmarking::BmBoxState::WAITING_MANUAL_OPERATION)
+                 || (bmbox_state == rockin_benchmarking::BmBoxState::TRANSMITTING_GOAL)
+                 || (bmbox_state == rockin_benchmarking::BmBoxState::END);
+        case rockin_benchmarking::RefBoxState::END:
+          return bmbox_state == rockin_benchmarking::BmBoxState::END;
+        default:
+          return true;
       }
     }
 
@@ -628,7 +837,7 @@ class ExecutingExternallyControlledBenchmark
           break;
         case roah_rsbb_msgs::BenchmarkState_State_PREPARE:
           if (last_bmbox_state_->state == rockin_benchmarking::BmBoxState::TRANSMITTING_SCORE) {
-            if (event_.benchmark_code == "HNF") {
+            if (bmbox_ == BMBOX_FBM2) {
               if (location_idx_ >= fbm2_num_points_) {
                 set_client_state (now, rockin_benchmarking::ClientState::END);
                 set_refbox_state (now, rockin_benchmarking::RefBoxState::RECEIVED_SCORE);
@@ -658,19 +867,17 @@ class ExecutingExternallyControlledBenchmark
               // Resume main timer
               time_.resume (now);
 
-              YAML::Node node = YAML::Load (last_bmbox_state_->payload);
-              goal_initial_state_.clear();
-              for (auto const& i : node[0]["initial_state"]) {
-                goal_initial_state_.push_back (i.as<int>() ? true : false);
-              }
+              std::shared_ptr<const bmbox_payload::Goal> goal = bmbox_payload::goal (last_bmbox_state_->payload);
+              goal_initial_state_ = goal->initial_state;
               for (size_t i = 0; i < goal_initial_state_.size(); ++i) {
                 if (goal_initial_state_[i]) {
                   on_switches_.insert (i + 1);
                 }
               }
               goal_switches_.clear();
-              for (auto const& i : node[0]["switches"]) {
-                goal_switches_.push_back (i.as<uint32_t>() + param_direct<int> ("~switch_ids_bmbox_to_right", 1));
+              int switch_offset = param_direct<int> ("~switch_ids_bmbox_to_right", 1);
+              for (uint32_t i : goal->switches) {
+                goal_switches_.push_back (i + switch_offset);
               }
 
               log_.log_string ("/rsbb_log/bmbox/goal", now, last_bmbox_state_->payload);
@@ -732,7 +939,7 @@ class ExecutingExternallyControlledBenchmark
         case roah_rsbb_msgs::BenchmarkState_State_STOP:
           break;
         case roah_rsbb_msgs::BenchmarkState_State_PREPARE:
-          /* if (event_.benchmark_code == "HNF") { */
+          /* if (bmbox_ == BMBOX_FBM2) { */
           /*   set_state (now, roah_rsbb_msgs::BenchmarkState_State_GOAL_TX, "Robot is waiting for goal."); */
           /*   set_refbox_state (now, rockin_benchmarking::RefBoxState::EXECUTING_GOAL); */
           /*   set_client_state (now, rockin_benchmarking::ClientState::WAITING_GOAL); */
@@ -764,7 +971,7 @@ class ExecutingExternallyControlledBenchmark
               //ROS_INFO("-------------------ROBOT: at_waiting_result");
               if (exec_duration_.isZero()) {
                 exec_duration_ = now - last_exec_start_;
-                if (event_.benchmark_code == "HOMF") {
+                if (bmbox_ == BMBOX_OMF) {
                   set_state (now, state_, "Robot finished executing. Waiting for switches input from referee.");
 
                   //ROS_INFO("-------------------ROBOT: at_waiting_Result_2");
@@ -773,20 +980,15 @@ class ExecutingExternallyControlledBenchmark
                 }
               }
 
-              if (event_.benchmark_code == "HOPF") {
-                YAML::Node node;
-                // node["object_class"] = msg.has_object_class() ? msg.object_class() : "";
-                // node["object_name"] = msg.has_object_class() ? msg.object_name() : "";
-                // node["object_pose"]["x"] = msg.has_object_class() ? msg.object_pose_x() : 0;
-                // node["object_pose"]["y"] = msg.has_object_class() ? msg.object_pose_y() : 0;
-                // node["object_pose"]["theta"] = msg.has_object_class() ? msg.object_pose_theta() : 0;
-                node["item_class"] = msg.has_object_class() ? msg.object_class() : "";
-                node["item_instance"] = msg.has_object_class() ? msg.object_name() : "";
-                node["x"] = msg.has_object_class() ? msg.object_pose_x() : 0;
-                node["y"] = msg.has_object_class() ? msg.object_pose_y() : 0;
-                node["theta"] = msg.has_object_class() ? msg.object_pose_theta() : 0;
-                node["execution_time"] = exec_duration_.toSec();
-                string result = YAML::Dump (node);
+              if (bmbox_ == BMBOX_FBM1) {
+                bmbox_payload::MapWriter w;
+                w.add ("item_class", msg.has_object_class() ? msg.object_class() : "");
+                w.add ("item_instance", msg.has_object_class() ? msg.object_name() : "");
+                w.add ("x", msg.has_object_class() ? msg.object_pose_x() : 0);
+                w.add ("y", msg.has_object_class() ? msg.object_pose_y() : 0);
+                w.add ("theta", msg.has_object_class() ? msg.object_pose_theta() : 0);
+                w.add ("execution_time", exec_duration_.toSec());
+                string result = w.str();
 
                 log_.log_string ("/rsbb_log/opf_result", now, result);
 
@@ -794,10 +996,10 @@ class ExecutingExternallyControlledBenchmark
                 set_client_state (now, rockin_benchmarking::ClientState::COMPLETED_GOAL, result);
                 check_bmbox_transition();
               }
-              else if (event_.benchmark_code == "HOMF") {
+              else if (bmbox_ == BMBOX_OMF) {
                 waiting_for_omf_complete_ = true;
               }
-              else if (event_.benchmark_code == "HNF") {
+              else if (bmbox_ == BMBOX_FBM2) {
                 if (location_idx_ < fbm2_num_points_) {
                   location_idx_++;
                   if (location_idx_ == fbm2_num_points_) {
@@ -828,12 +1030,15 @@ class ExecutingExternallyControlledBenchmark
         /*   msg.add_switches (i); */
         /* } */
 
-        msg.set_target_pose_x (fbm2_locations_[location_idx_][0]);
-        msg.set_target_pose_y (fbm2_locations_[location_idx_][1]);
-        msg.set_target_pose_theta (fbm2_locations_[location_idx_][2]);
+        if (location_idx_ < fbm2_num_points_) {
+          Fbm2Config::Pose const& wp = fbm2_->waypoints[location_idx_];
+          msg.set_target_pose_x (wp.x);
+          msg.set_target_pose_y (wp.y);
+          msg.set_target_pose_theta (wp.theta);
 
-        ROS_INFO ("Publishing Goal!!");
-        ROS_INFO ("Goal: %f, %f, %f", fbm2_locations_[location_idx_][0], fbm2_locations_[location_idx_][1], fbm2_locations_[location_idx_][2]);
+          ROS_INFO ("Publishing Goal!!");
+          ROS_INFO ("Goal: %f, %f, %f", wp.x, wp.y, wp.theta);
+        }
       }
     }
 
@@ -847,6 +1052,15 @@ class ExecutingExternallyControlledBenchmark
       }
       last_bmbox_state_ = msg;
 
+      // Only take as received the states this transition answers, the
+      // other one may not have been processed yet
+      if (bmbox_answers_client (msg->state, client_state_pub_.state())) {
+        client_state_pub_.ack (now);
+      }
+      if (bmbox_answers_refbox (msg->state, refbox_state_pub_.state())) {
+        refbox_state_pub_.ack (now);
+      }
+
       if (phase_ != PHASE_EXEC) {
         return;
       }
@@ -868,8 +1082,8 @@ class ExecutingExternallyControlledBenchmark
       // Therefore, timeout refers to each object and a total_timeout
       // is added for the whole benchmark.
       total_timeout_ -= time_.get_elapsed (now);
-      if (event_.benchmark.timeout < total_timeout_) {
-        time_.start_reset (now, event_.benchmark.timeout);
+      if (event_.benchmark->timeout < total_timeout_) {
+        time_.start_reset (now, event_.benchmark->timeout);
         last_timeout_ = false;
       }
       else {
@@ -894,7 +1108,7 @@ class ExecutingExternallyControlledBenchmark
           /*   return; */
           /* } */
           // If there is a partial timeout, update the FBM2 location index accordingly
-          if (event_.benchmark_code == "HNF") {
+          if (bmbox_ == BMBOX_FBM2) {
             if (location_idx_ < fbm2_num_points_) {
               location_idx_++;
               set_client_state (now, rockin_benchmarking::ClientState::COMPLETED_GOAL, "reason: timeout");
@@ -930,11 +1144,8 @@ class ExecutingExternallyControlledBenchmark
     string
     bmbox_prefix (Event const& event)
     {
-      if (event.benchmark_code == "HOPF") {
-        return "/fbm1h/";
-      }
-      else if (event.benchmark_code == "HNF") {
-        return "/fbm2h/";
+      if (! event.type->bmbox_prefix.empty()) {
+        return event.type->bmbox_prefix;
       }
 
       ROS_FATAL_STREAM ("Cannot execute benchmark of type " << event.benchmark_code << " with ExecutingExternallyControlledBenchmark");
@@ -948,82 +1159,28 @@ class ExecutingExternallyControlledBenchmark
                                             boost::function<void() > end,
                                             string const& robot_name)
       : ExecutingSingleRobotBenchmark (ss, event, end, robot_name)
+      , bmbox_ (event.type->bmbox)
       , waiting_for_omf_complete_ (false)
       , refbox_state_ (rockin_benchmarking::RefBoxState::START)
       , client_state_ (rockin_benchmarking::ClientState::START)
-      , client_state_pub_ (ss_.nh.advertise<rockin_benchmarking::ClientState> (bmbox_prefix (event) + "client_state", 1, true))
-      , refbox_state_pub_ (ss_.nh.advertise<rockin_benchmarking::RefBoxState> (bmbox_prefix (event) + "refbox_state", 1, true))
+      , client_state_pub_ (ss_.nh, bmbox_prefix (event) + "client_state")
+      , refbox_state_pub_ (ss_.nh, bmbox_prefix (event) + "refbox_state")
       , bmbox_state_sub_ (ss_.nh.subscribe (bmbox_prefix (event) + "bmbox_state", 1, &ExecutingExternallyControlledBenchmark::bmbox_state_callback, this))
       , last_bmbox_state_ (boost::make_shared<rockin_benchmarking::BmBoxState>())
-      , annoying_timer_ (ss_.nh.createTimer (Duration (0.2), &ExecutingExternallyControlledBenchmark::annoying_timer, this))
-      , total_timeout_ (event.benchmark.total_timeout)
+      , retransmit_timer_ (ss_.timers.every (Duration (0.1), boost::bind (&ExecutingExternallyControlledBenchmark::retransmit_timer, this, _1), "bmbox_retransmit"))
+      , total_timeout_ (event.benchmark->total_timeout)
+      , fbm2_ (ss_.fbm2_waypoints.get())
       , location_idx_ (0)
+      , fbm2_num_points_ (fbm2_ ? fbm2_->waypoints.size() : 0)
     {
-      Time now = Time::now();
-
-      std::vector< std::vector<double> > temp;
-
-      string fbm2_locations;
-      ss_.nh.getParam ("/roah_rsbb_core/fbm2_locations_file", fbm2_locations);
-      YAML::Node fbm2_config = YAML::LoadFile (fbm2_locations);
-
-      if (!fbm2_config["goal"]["starting_pose"]) {
-        ROS_FATAL_STREAM ("FBM2H file is missing a \"starting_pose\" entry!");
-        abort_rsbb();
-      }
-      else {
-        fbm2_starting_pose_ = fbm2_config["goal"]["starting_pose"].as<std::vector<double>>();
-      }
-
-      if (!fbm2_config["goal"]["penalty_time"]) {
-        ROS_FATAL_STREAM ("FBM2H file is missing a \"penalty_time\" entry!");
+      if ( (bmbox_ == BMBOX_FBM2) && (! fbm2_)) {
+        ROS_FATAL_STREAM ("No valid FBM2 configuration loaded from ~fbm2_locations_file");
         abort_rsbb();
       }
-      else {
-        fbm2_penalty_time_ = fbm2_config["goal"]["penalty_time"].as<double>();
-      }
 
-      if (!fbm2_config["goal"]["timeout_time"]) {
-        ROS_FATAL_STREAM ("FBM2H file is missing a \"timeout_time\" entry!");
-        abort_rsbb();
+      if (fbm2_) {
+        log_.log_string ("/rsbb_log/waypoints_loading", Time::now(), fbm2_->description);
       }
-      else {
-        fbm2_timeout_time_ = fbm2_config["goal"]["timeout_time"].as<double>();
-      }
-
-      if (!fbm2_config["goal"]["waypoints"]) {
-        ROS_FATAL_STREAM ("FBM2H file is missing a \"timeout_time\" entry!");
-        abort_rsbb();
-      }
-      else {
-        for (YAML::const_iterator it = fbm2_config["goal"]["waypoints"].begin(); it != fbm2_config["goal"]["waypoints"].end(); ++it) {
-          std::vector<double> wp = (*it).as<std::vector<double>>();
-          temp.push_back (wp);
-        }
-      }
-
-      fbm2_locations_ = temp;
-      fbm2_num_points_ = fbm2_locations_.size();
-
-      ostringstream pl;
-
-      pl << "RefBox - FBM2 Config:" << endl;
-      pl << "Penalty Time: " << fbm2_penalty_time_ << endl;
-      pl << "Timeout Time: " << fbm2_timeout_time_ << endl;
-
-      pl << "Starting Pose: [ ";
-      for (auto i = fbm2_starting_pose_.begin(); i != fbm2_starting_pose_.end(); ++i) {
-        pl << *i << ' ';
-      }
-      pl << "]" << endl;
-
-      pl << "Waypoints: " << endl;
-      for (uint i = 0; i < fbm2_locations_.size(); i++) {
-        pl << "\tWP #" << i << ": [ " << fbm2_locations_[i][0] << ' ' << fbm2_locations_[i][1] << ' ' << fbm2_locations_[i][2] << " ]" << endl;
-      }
-      pl << endl;
-
-      log_.log_string ("/rsbb_log/waypoints_loading", now, pl.str());
     }
 
     void
@@ -1053,18 +1210,20 @@ class ExecutingExternallyControlledBenchmark
           exec_duration_ = now - last_exec_start_;
         }
 
-        YAML::Node node;
-        node["switches"] = YAML::Node (YAML::NodeType::Sequence);
+        int switch_offset = param_direct<int> ("~switch_ids_bmbox_to_right", 1);
+        vector<uint32_t> switches;
         for (auto const& i : changed_switches_) {
-          node["switches"].push_back (i - param_direct<int> ("~switch_ids_bmbox_to_right", 1));
+          switches.push_back (i - switch_offset);
         }
-        node["execution_time"] = exec_duration_.toSec();
-        node["damaged_switches"] = damaged_switches_;
+        bmbox_payload::MapWriter result;
+        result.add_sequence ("switches", switches);
+        result.add ("execution_time", exec_duration_.toSec());
+        result.add ("damaged_switches", damaged_switches_);
 
         log_.log_string ("/rsbb_log/omf_complete", now, last_bmbox_state_->payload);
 
         set_refbox_state (now, rockin_benchmarking::RefBoxState::READY);
-        set_client_state (now, rockin_benchmarking::ClientState::COMPLETED_GOAL, YAML::Dump (node));
+        set_client_state (now, rockin_benchmarking::ClientState::COMPLETED_GOAL, result.str());
         check_bmbox_transition();
 
         goal_initial_state_.clear();
@@ -1114,14 +1273,20 @@ class ExecutingExternallyControlledBenchmark
       else if (phase_ == PHASE_POST) {
         add_to_sting (zone.state) << "You may need to restart BmBox if you are to press start again";
       }
+      else {
+        add_to_sting t (zone.state);
+        t << "BmBox handshake RTT: " << static_cast<int> (max (client_state_pub_.last_rtt().toSec(), refbox_state_pub_.last_rtt().toSec()) * 1000) << " ms";
+        if (client_state_pub_.pending() || refbox_state_pub_.pending()) {
+          t << ", waiting for BmBox";
+        }
+        t << ", retransmissions: " << (client_state_pub_.retransmissions() + refbox_state_pub_.retransmissions());
+      }
 
-      if ( (event_.benchmark_code == "HNF")
+      if ( (bmbox_ == BMBOX_FBM2)
            && (! (goal_initial_state_.empty()))
            && (phase_ == PHASE_EXEC)) {
         zone.omf = true;
-        for (auto const& i : on_switches_) {
-          zone.omf_switches.push_back (i);
-        }
+        zone.omf_switches.assign (on_switches_.begin(), on_switches_.end());
         zone.omf_damaged = damaged_switches_;
         zone.omf_complete = waiting_for_omf_complete_;
       }
@@ -1136,7 +1301,8 @@ class ExecutingExternallyControlledBenchmark
 class ExecutingAllRobotsBenchmark
   : public ExecutingBenchmark
 {
-    vector<Event> dummy_events_;
+    // Copies of the event for each team; a deque, as the executors keep references
+    deque<Event> dummy_events_;
     vector<unique_ptr<ExecutingSimpleBenchmark>> simple_benchmarks_;
 
     void
@@ -1173,10 +1339,13 @@ class ExecutingAllRobotsBenchmark
           ROS_ERROR_STREAM ("Ignoring robot of team " << ri.team << " because it is already executing a benchmark");
           continue;
         }
+        if (! ss_.passwords.has (ri.team)) {
+          ROS_ERROR_STREAM ("Ignoring robot of team " << ri.team << " because it has no password");
+          continue;
+        }
 
         dummy_events_.push_back (event);
         dummy_events_.back().team = ri.team;
-        dummy_events_.back().password = ss_.passwords.get (dummy_events_.back().team);
 
         bool ok = false;
         do {
@@ -1227,4 +1396,67 @@ class ExecutingAllRobotsBenchmark
     }
 };
 
+
+
+template<typename T>
+ExecutingBenchmark*
+create_single_robot_benchmark (CoreSharedState& ss,
+                               Event const& event,
+                               boost::function<void() > end,
+                               string const& robot_name)
+{
+  return new T (ss, event, end, robot_name);
+}
+
+inline ExecutingBenchmark*
+create_all_robots_benchmark (CoreSharedState& ss,
+                             Event const& event,
+                             boost::function<void() > end,
+                             string const&)
+{
+  return new ExecutingAllRobotsBenchmark (ss, event, end);
+}
+
+inline void
+register_benchmark_types (BenchmarkTypes& types)
+{
+  BenchmarkType t;
+
+  t = BenchmarkType();
+  t.code = "HGTKMH";
+  t.create = &create_single_robot_benchmark<ExecutingSimpleBenchmark>;
+  types.add (t);
+
+  t = BenchmarkType();
+  t.code = "HWV";
+  t.create = &create_single_robot_benchmark<ExecutingSimpleBenchmark>;
+  types.add (t);
+
+  t = BenchmarkType();
+  t.code = "HCFGAC";
+  t.devices_control = true;
+  t.create = &create_single_robot_benchmark<ExecutingSimpleBenchmark>;
+  types.add (t);
+
+  t = BenchmarkType();
+  t.code = "HOPF";
+  t.bmbox = BMBOX_FBM1;
+  t.bmbox_prefix = "/fbm1h/";
+  t.create = &create_single_robot_benchmark<ExecutingExternallyControlledBenchmark>;
+  types.add (t);
+
+  t = BenchmarkType();
+  t.code = "HNF";
+  t.bmbox = BMBOX_FBM2;
+  t.bmbox_prefix = "/fbm2h/";
+  t.create = &create_single_robot_benchmark<ExecutingExternallyControlledBenchmark>;
+  types.add (t);
+
+  t = BenchmarkType();
+  t.code = "HSUF";
+  t.all_robots = true;
+  t.create = &create_all_robots_benchmark;
+  types.add (t);
+}
+
 #endif
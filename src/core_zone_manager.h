@@ -22,87 +22,127 @@
 
 #include "core_includes.h"
 
+#include <atomic>
+#include <thread>
+
 #include "core_shared_state.h"
 #include "core_zone_base.h"
 #include "core_zone_exec.h"
 
 
 
+typedef multimap<Time, const Event> Schedule;
+
+
+
+// Schedule of one zone as read from the schedule file
+struct ZoneSchedule {
+  string name;
+  Schedule events;
+
+  // Throws ConfigError or YAML::Exception
+  ZoneSchedule (BenchmarkTypes const& types,
+                Benchmarks const& benchmarks,
+                Passwords const& passwords,
+                YAML::Node const& zone_node)
+  {
+    if (! zone_node["zone"]) {
+      throw ConfigError ("Schedule file is missing a \"zone\" entry!");
+    }
+    name = zone_node["zone"].as<string>();
+
+    if (! zone_node["schedule"]) {
+      throw ConfigError ("Schedule file is missing a \"schedule\" entry!");
+    }
+    if (! zone_node["schedule"].IsSequence()) {
+      throw ConfigError ("Schedule in schedule file is not a sequence!");
+    }
+    for (YAML::Node const& event_node : zone_node["schedule"]) {
+      Event e = Event (event_node);
+      e.type = types.find (e.benchmark_code);
+      if (! e.type) {
+        throw ConfigError ("Zone " + name + ": unsupported benchmark code " + e.benchmark_code.str());
+      }
+      if (e.type->all_robots && (e.team != "ALL")) {
+        throw ConfigError ("Zone " + name + ": benchmark code " + e.benchmark_code.str() + " only supported for team ALL");
+      }
+      if ( (! e.type->all_robots) && (e.team == "ALL")) {
+        throw ConfigError ("Zone " + name + ": benchmark code " + e.benchmark_code.str() + " not supported for team ALL");
+      }
+
+      e.benchmark = benchmarks.get (e.benchmark_code);
+      if ( (e.team != "ALL") && (! passwords.has (e.team))) {
+        throw ConfigError ("Zone " + name + ": could not find password for team \"" + e.team.str() + "\"");
+      }
+      events.insert (make_pair (e.scheduled_time, e));
+    }
+
+    if (events.empty()) {
+      throw ConfigError ("Zone " + name + " has no schedule defined");
+    }
+  }
+};
+
+
+
 class Zone
   : boost::noncopyable
 {
     CoreSharedState& ss_;
 
     string name_;
-    multimap<Time, const Event> events_;
-    multimap<Time, const Event>::const_iterator current_event_;
+    Schedule events_;
+    Schedule::const_iterator current_event_;
 
+    // Executors keep a reference to their event, which must survive a reload
+    std::shared_ptr<const Event> executing_event_;
     unique_ptr<ExecutingBenchmark> executing_benchmark_;
 
+    // Set while the zone is out of the schedule, called after the run ends
+    boost::function<void() > removed_;
+
   public:
     typedef std::shared_ptr<Zone> Ptr;
 
     Zone (CoreSharedState& ss,
-          YAML::Node const& zone_node)
+          ZoneSchedule const& schedule)
       : ss_ (ss)
+      , name_ (schedule.name)
+      , events_ (schedule.events)
+      , current_event_ (events_.cbegin())
     {
-      if (! zone_node["zone"]) {
-        ROS_FATAL_STREAM ("Schedule file is missing a \"zone\" entry!");
-        abort_rsbb();
-      }
-      name_ = zone_node["zone"].as<string>();
-
-      if (! zone_node["schedule"]) {
-        ROS_FATAL_STREAM ("Schedule file is missing a \"schedule\" entry!");
-        abort_rsbb();
-      }
-      if (! zone_node["schedule"].IsSequence()) {
-        ROS_FATAL_STREAM ("Schedule in schedule file is not a sequence!");
-        abort_rsbb();
-      }
-      for (YAML::Node const& event_node : zone_node["schedule"]) {
-        Event e = Event (event_node);
-        e.benchmark = ss_.benchmarks.get (e.benchmark_code);
-        if (e.team != "ALL") {
-          e.password = ss_.passwords.get (e.team);
-        }
-        events_.insert (make_pair (e.scheduled_time, e));
-
-        if (! ( (e.benchmark_code == "HGTKMH")
-                || (e.benchmark_code == "HWV")
-                || (e.benchmark_code == "HCFGAC")
-                || (e.benchmark_code == "HOPF")
-                || (e.benchmark_code == "HNF")
-                || (e.benchmark_code == "HSUF"))) {
-          ROS_FATAL_STREAM ("Zone " << name_ << ": unsupported benchmark code " << e.benchmark_code);
-          abort_rsbb();
-        }
-
-        if (e.benchmark_code == "HSUF") {
-          if (e.team != "ALL") {
-            ROS_FATAL_STREAM ("Zone " << name_ << ": benchmark code HSUF only supported for team ALL");
-            abort_rsbb();
-          }
-        }
+    }
 
-        if ( (e.benchmark_code == "HGTKMH")
-             || (e.benchmark_code == "HWV")
-             || (e.benchmark_code == "HCFGAC")
-             || (e.benchmark_code == "HOPF")
-             || (e.benchmark_code == "HNF")) {
-          if (e.team == "ALL") {
-            ROS_FATAL_STREAM ("Zone " << name_ << ": benchmark code " << e.benchmark_code << " not supported for team ALL");
-            abort_rsbb();
-          }
+    // Replaces the schedule, keeping the current entry when it still
+    // exists. A running benchmark keeps its own copy of its event.
+    void
+    set_schedule (Schedule const& events)
+    {
+      Event current = current_event_->second;
+
+      events_ = events;
+      current_event_ = events_.lower_bound (current.scheduled_time);
+      for (auto i = current_event_; (i != events_.cend()) && (i->first == current.scheduled_time); ++i) {
+        if (i->second.same_entry (current)) {
+          current_event_ = i;
+          break;
         }
       }
-
-      if (events_.empty()) {
-        ROS_FATAL_STREAM ("Zone " << name_ << " has no schedule defined");
-        abort_rsbb();
+      if (current_event_ == events_.cend()) {
+        current_event_ = prev (events_.cend());
       }
+    }
+
+    Schedule const&
+    events() const
+    {
+      return events_;
+    }
 
-      current_event_ = events_.cbegin();
+    bool
+    executing() const
+    {
+      return static_cast<bool> (executing_benchmark_);
     }
 
     string
@@ -115,6 +155,22 @@ class Zone
     end()
     {
       getGlobalCallbackQueue()->addCallback (boost::make_shared<roah_rsbb::CallbackItem> (boost::bind (&unique_ptr<ExecutingBenchmark>::reset, &executing_benchmark_, nullptr)));
+      if (removed_) {
+        getGlobalCallbackQueue()->addCallback (boost::make_shared<roah_rsbb::CallbackItem> (removed_));
+      }
+    }
+
+    // f is queued once the running benchmark ends, an empty f cancels it
+    void
+    remove_when_idle (boost::function<void() > const& f)
+    {
+      removed_ = f;
+    }
+
+    bool
+    removing() const
+    {
+      return static_cast<bool> (removed_);
     }
 
     void
@@ -127,44 +183,34 @@ class Zone
 
       ROS_DEBUG_STREAM ("Zone: " << name() << " CONNECT");
 
-      if (current_event_->second.benchmark_code == "HSUF") {
-        if (current_event_->second.team != "ALL") {
-          ROS_FATAL_STREAM ("Zone " << name_ << ": benchmark code HSUF only supported for team ALL");
-          abort_rsbb();
-        }
-
-        executing_benchmark_.reset (new ExecutingAllRobotsBenchmark (ss_, current_event_->second, boost::bind (&Zone::end, this)));
+      executing_event_ = make_shared<const Event> (current_event_->second);
+      Event const& event = *executing_event_;
 
+      if (event.type->all_robots) {
+        executing_benchmark_.reset (event.type->create (ss_, event, boost::bind (&Zone::end, this), ""));
         return;
       }
 
-      roah_rsbb::RobotInfo ri = ss_.active_robots.get (current_event_->second.team);
+      roah_rsbb::RobotInfo ri = ss_.active_robots.get (event.team);
       if (ri.team.empty()) {
         ROS_WARN_STREAM ("Zone: " << name() << " CONNECT ignored because robot not present");
         return;
       }
 
-      if (ss_.benchmarking_robots.count (current_event_->second.team)) {
-        ROS_ERROR_STREAM ("Zone: " << name() << " CONNECT ignored because robot of team " << current_event_->second.team << " is already executing a benchmark");
+      if (ss_.benchmarking_robots.count (event.team)) {
+        ROS_ERROR_STREAM ("Zone: " << name() << " CONNECT ignored because robot of team " << event.team << " is already executing a benchmark");
+        return;
+      }
+
+      if (! ss_.passwords.has (event.team)) {
+        ROS_ERROR_STREAM ("Zone: " << name() << " CONNECT ignored because team " << event.team << " has no password");
         return;
       }
 
       bool ok = false;
       do {
         try {
-          if ( (current_event_->second.benchmark_code == "HGTKMH")
-               || (current_event_->second.benchmark_code == "HWV")
-               || (current_event_->second.benchmark_code == "HCFGAC")) {
-            executing_benchmark_.reset (new ExecutingSimpleBenchmark (ss_, current_event_->second, boost::bind (&Zone::end, this), ri.robot));
-          }
-          else if ( (current_event_->second.benchmark_code == "HOPF")
-                    || (current_event_->second.benchmark_code == "HNF")) {
-            executing_benchmark_.reset (new ExecutingExternallyControlledBenchmark (ss_, current_event_->second, boost::bind (&Zone::end, this), ri.robot));
-          }
-          else {
-            ROS_FATAL_STREAM ("Zone " << name_ << " unsupported benchmark code: " << current_event_->second.benchmark_code);
-            abort_rsbb();
-          }
+          executing_benchmark_.reset (event.type->create (ss_, event, boost::bind (&Zone::end, this), ri.robot));
           ok = true;
         }
         catch (const std::exception& exc) {
@@ -301,24 +347,42 @@ class Zone
       }
     }
 
-    roah_rsbb::ZoneState
-    msg (Time const& now)
+    // Refills zone in place, keeping the storage of the last fill. The logs
+    // are left empty without texts.
+    void
+    msg (Time const& now,
+         roah_rsbb::ZoneState& zone,
+         bool texts = true)
     {
-      roah_rsbb::ZoneState zone;
-
-      zone.zone = name();
-
-      zone.name = current_event_->second.benchmark.name;
-      zone.desc = current_event_->second.benchmark.desc;
-      zone.code = current_event_->second.benchmark.code;
-      zone.timeout = current_event_->second.benchmark.timeout;
-      zone.team = current_event_->second.team;
-      zone.round = current_event_->second.round;
-      zone.run = current_event_->second.run;
-      zone.schedule = current_event_->second.scheduled_time;
+      zone.zone.assign (name());
+
+      Event const& event = executing_benchmark_ ? *executing_event_ : current_event_->second;
+      zone.name.assign (event.benchmark->name);
+      zone.desc.assign (event.benchmark->desc);
+      zone.code.assign (event.benchmark->code);
+      zone.timeout = event.benchmark->timeout;
+      zone.team.assign (event.team);
+      zone.round = event.round;
+      zone.run = event.run;
+      zone.schedule = event.scheduled_time;
+
+      zone.state.clear();
+      zone.manual_operation.clear();
+      zone.omf = false;
+      zone.omf_switches.clear();
+      zone.omf_damaged = 0;
+      zone.omf_complete = false;
+      zone.log.topics.clear();
+      zone.log.entries.clear();
+      zone.online_data.topics.clear();
+      zone.online_data.entries.clear();
 
       if (executing_benchmark_) {
         executing_benchmark_->fill (now, zone);
+        if (texts) {
+          executing_benchmark_->log().fill (zone.log);
+          executing_benchmark_->online_data().fill (zone.online_data);
+        }
 
         zone.connect_enabled = false;
         zone.disconnect_enabled = true;
@@ -326,15 +390,14 @@ class Zone
         zone.next_enabled = false;
       }
       else {
-        zone.timer = current_event_->second.benchmark.timeout;
-        zone.state = "";
-        zone.manual_operation = "";
+        zone.timer = current_event_->second.benchmark->timeout;
+        zone.scoring.clear();
 
         zone.start_enabled = false;
         zone.stop_enabled = false;
 
         Duration allowed_skew = Duration (param_direct<double> ("~allowed_skew", 0.5));
-        if (current_event_->second.benchmark.code == "HSUF") {
+        if (current_event_->second.type->all_robots) {
           vector<string> teams_out_of_sync;
           for (roah_rsbb::RobotInfo const& ri : ss_.active_robots.get ()) {
             if ( ( (-allowed_skew) >= ri.skew) || (ri.skew >= allowed_skew)) {
@@ -380,31 +443,79 @@ class Zone
         zone.prev_enabled = current_event_ != events_.cbegin();
         zone.next_enabled = current_event_ != prev (events_.cend());
       }
+    }
 
-      return zone;
+    // Logs of the running benchmark, null if none
+    LogRing const*
+    log() const
+    {
+      return executing_benchmark_ ? &executing_benchmark_->log() : nullptr;
+    }
+
+    LogRing const*
+    online_data() const
+    {
+      return executing_benchmark_ ? &executing_benchmark_->online_data() : nullptr;
     }
 
+    // Refills entries from position n in place, the time is only
+    // formatted again when it changed
     void
     msg (Time const& now,
-         multimap<Time, roah_rsbb::ScheduleInfo>& map)
+         vector<pair<Time, roah_rsbb::ScheduleInfo>>& entries,
+         size_t& n)
     {
-      for (multimap<Time, const Event>::const_iterator i = events_.cbegin();
+      for (Schedule::const_iterator i = events_.cbegin();
            i != events_.cend();
            ++i) {
-        roah_rsbb::ScheduleInfo msg;
-        msg.team = i->second.team;
-        msg.benchmark = i->second.benchmark.desc;
+        if (n == entries.size()) {
+          entries.push_back (make_pair (TIME_MIN, roah_rsbb::ScheduleInfo()));
+        }
+        pair<Time, roah_rsbb::ScheduleInfo>& entry = entries[n++];
+        roah_rsbb::ScheduleInfo& msg = entry.second;
+        msg.team.assign (i->second.team);
+        msg.benchmark.assign (i->second.benchmark->desc);
         msg.round = i->second.round;
         msg.run = i->second.run;
-        msg.time = to_string (i->second.scheduled_time);
-        msg.running = ( (i == current_event_) && executing_benchmark_);
-        map.insert (make_pair (i->second.scheduled_time, msg));
+        if ( (entry.first != i->second.scheduled_time) || msg.time.empty()) {
+          entry.first = i->second.scheduled_time;
+          msg.time = to_string (entry.first);
+        }
+        msg.running = executing_benchmark_ && i->second.same_entry (*executing_event_);
       }
     }
 };
 
 
 
+/*
+ * Schedule, benchmarks and passwords as read from their files, parsed
+ * together so that they are consistent with each other.
+ */
+struct Configuration {
+  Benchmarks benchmarks;
+  Passwords passwords;
+  vector<ZoneSchedule> zones;
+
+  // Throws ConfigError or YAML::Exception
+  Configuration (BenchmarkTypes const& types,
+                 Benchmarks const& benchmarks_in,
+                 Passwords const& passwords_in)
+    : benchmarks (benchmarks_in)
+    , passwords (passwords_in)
+  {
+    YAML::Node file = YAML::LoadFile (param_direct<string> ("~schedule_file", "schedule.yaml"));
+    if (! file.IsSequence()) {
+      throw ConfigError ("Schedule file is not a sequence!");
+    }
+    for (YAML::Node const& zone_node : file) {
+      zones.push_back (ZoneSchedule (types, benchmarks, passwords, zone_node));
+    }
+  }
+};
+
+
+
 class CoreZoneManager
   : boost::noncopyable
 {
@@ -412,23 +523,154 @@ class CoreZoneManager
 
     map<string, Zone::Ptr> zones_;
 
+    ServiceServer reload_srv_;
+    std::thread reload_thread_;
+    std::atomic<bool> reloading_;
+
+    // Runs in reload_thread_
+    void
+    parse_configuration()
+    {
+      std::shared_ptr<Configuration> config;
+      string error;
+      try {
+        config = make_shared<Configuration> (ss_.benchmark_types,
+                                             Benchmarks (param_direct<string> ("~benchmarks_file", "benchmarks.yaml")),
+                                             Passwords (param_direct<string> ("~passwords_file", "passwords.yaml")));
+      }
+      catch (std::exception const& e) {
+        error = e.what();
+      }
+      getGlobalCallbackQueue()->addCallback (boost::make_shared<roah_rsbb::CallbackItem> (boost::bind (&CoreZoneManager::apply_configuration, this, config, error)));
+    }
+
+    // Runs in the ROS thread, so nothing else sees a partial update
+    void
+    apply_configuration (std::shared_ptr<Configuration> config,
+                         string const& error)
+    {
+      if (reload_thread_.joinable()) {
+        reload_thread_.join();
+      }
+      reloading_ = false;
+
+      if (! config) {
+        ROS_ERROR_STREAM ("Reload failed, keeping the current configuration: " << error);
+        return;
+      }
+
+      vector<Symbol> changed_benchmarks = config->benchmarks.share_unchanged (ss_.benchmarks);
+      // Events of changed benchmarks must refer to the new definitions
+      for (ZoneSchedule& zs : config->zones) {
+        Schedule events;
+        for (auto const& i : zs.events) {
+          Event e = i.second;
+          e.benchmark = config->benchmarks.get (e.benchmark_code);
+          events.insert (make_pair (i.first, e));
+        }
+        zs.events.swap (events);
+      }
+      bool passwords_changed = ! (config->passwords == ss_.passwords);
+      ss_.benchmarks = config->benchmarks;
+      ss_.passwords = config->passwords;
+
+      unsigned added = 0;
+      unsigned modified = 0;
+      unsigned removed = 0;
+      set<string> names;
+      for (ZoneSchedule const& zs : config->zones) {
+        names.insert (zs.name);
+        auto z = zones_.find (zs.name);
+        if (z == zones_.end()) {
+          zones_[zs.name] = make_shared<Zone> (ss_, zs);
+          ++added;
+          continue;
+        }
+        z->second->remove_when_idle (boost::function<void() >());
+        if (z->second->events() != zs.events) {
+          z->second->set_schedule (zs.events);
+          ++modified;
+        }
+      }
+      for (auto z = zones_.begin(); z != zones_.end();) {
+        if (names.count (z->first)) {
+          ++z;
+        }
+        else if (z->second->executing()) {
+          ROS_WARN_STREAM ("Zone " << z->first << " was removed from the schedule but is executing a benchmark, removing it when it ends");
+          z->second->remove_when_idle (boost::bind (&CoreZoneManager::erase_idle_zone, this, z->first));
+          ++z;
+        }
+        else {
+          z = zones_.erase (z);
+          ++removed;
+        }
+      }
+
+      ROS_INFO_STREAM ("Reloaded configuration: " << added << " zones added, "
+                       << modified << " modified, " << removed << " removed; "
+                       << changed_benchmarks.size() << " benchmarks added or changed"
+                       << (passwords_changed ? "; passwords changed" : ""));
+    }
+
+    void
+    erase_idle_zone (string const& name)
+    {
+      auto z = zones_.find (name);
+      if ( (z != zones_.end()) && z->second->removing() && ! z->second->executing()) {
+        zones_.erase (z);
+        ROS_INFO_STREAM ("Zone " << name << " removed after its benchmark ended");
+      }
+    }
+
+    bool
+    reload_callback (std_srvs::Empty::Request& req,
+                     std_srvs::Empty::Response& res)
+    {
+      if (reloading_.exchange (true)) {
+        ROS_WARN_STREAM ("Reload already in progress, ignored");
+        return false;
+      }
+      ROS_INFO_STREAM ("Reloading schedule, benchmarks and passwords");
+      reload_thread_ = std::thread (&CoreZoneManager::parse_configuration, this);
+      return true;
+    }
+
   public:
     CoreZoneManager (CoreSharedState& ss)
       : ss_ (ss)
+      , reloading_ (false)
     {
-      using namespace YAML;
+      register_benchmark_types (ss_.benchmark_types);
 
-      Node file = LoadFile (param_direct<string> ("~schedule_file", "schedule.yaml"));
-      if (! file.IsSequence()) {
-        ROS_FATAL_STREAM ("Schedule file is not a sequence!");
+      std::shared_ptr<Configuration> config;
+      try {
+        config = make_shared<Configuration> (ss_.benchmark_types, ss_.benchmarks, ss_.passwords);
+      }
+      catch (std::exception const& e) {
+        ROS_FATAL_STREAM ("Error loading schedule: " << e.what());
         abort_rsbb();
       }
-      for (Node const& zone_node : file) {
-        Zone::Ptr zone = make_shared<Zone> (ss_, zone_node);
-        zones_[zone->name()] = zone;
+      for (ZoneSchedule const& zs : config->zones) {
+        zones_[zs.name] = make_shared<Zone> (ss_, zs);
+      }
+
+      reload_srv_ = ss_.nh.advertiseService ("/core/reload", &CoreZoneManager::reload_callback, this);
+    }
+
+    ~CoreZoneManager()
+    {
+      if (reload_thread_.joinable()) {
+        reload_thread_.join();
       }
     }
 
+    map<string, Zone::Ptr> const&
+    zones() const
+    {
+      return zones_;
+    }
+
     Zone::Ptr
     get (string const& name)
     {
@@ -439,26 +681,35 @@ class CoreZoneManager
       return Zone::Ptr();
     }
 
+    // Refills msg in place
     void
     msg (Time const& now,
          vector<roah_rsbb::ZoneState>& msg)
     {
+      size_t n = 0;
       for (auto const& i : zones_) {
         if (i.second) {
-          msg.push_back (i.second->msg (now));
+          if (n == msg.size()) {
+            msg.push_back (roah_rsbb::ZoneState());
+          }
+          i.second->msg (now, msg[n++]);
         }
       }
+      msg.resize (n);
     }
 
+    // Refills entries in place, in no particular order
     void
     msg (Time const& now,
-         multimap<Time, roah_rsbb::ScheduleInfo>& map)
+         vector<pair<Time, roah_rsbb::ScheduleInfo>>& entries)
     {
+      size_t n = 0;
       for (auto const& i : zones_) {
         if (i.second) {
-          i.second->msg (now, map);
+          i.second->msg (now, entries, n);
         }
       }
+      entries.resize (n);
     }
 };
 
@@ -0,0 +1,852 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * State gateway for displays that do not run a ROS node.
+ *
+ * Subscribes once to /core/to_gui and /core/to_public and serves the state
+ * over HTTP:
+ *  - GET /state  returns a full JSON snapshot;
+ *  - GET /events is a Server-Sent Events stream that starts with a snapshot
+ *    and continues with deltas containing only the sections that changed.
+ *
+ * Every section is serialised once per change and shared by all clients.
+ * Deltas are only built when there are streams, and the snapshot only when
+ * a client asks for it. A client that falls more than ~max_queue messages
+ * behind has its queue dropped and receives a fresh snapshot once its
+ * socket drains. Requests longer than ~max_request bytes are dropped.
+ */
+
+#include <cstdio>
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <ros/ros.h>
+
+#include <roah_rsbb/CoreToGui.h>
+#include <roah_rsbb/CoreToPublic.h>
+
+#include <ros_roah_rsbb.h>
+
+
+
+using namespace std;
+using namespace ros;
+using boost::asio::ip::tcp;
+
+
+
+typedef std::shared_ptr<const string> SharedText;
+
+
+
+class JsonOut
+  : boost::noncopyable
+{
+    ostringstream o_;
+    bool first_;
+
+    void
+    sep()
+    {
+      if (! first_) {
+        o_ << ',';
+      }
+      first_ = false;
+    }
+
+  public:
+    JsonOut()
+      : first_ (true)
+    {
+      o_ << setprecision (15);
+    }
+
+    static void
+    quote (ostream& o,
+           string const& s)
+    {
+      o << '"';
+      for (char c : s) {
+        switch (c) {
+          case '"':
+            o << "\\\"";
+            break;
+          case '\\':
+            o << "\\\\";
+            break;
+          case '\n':
+            o << "\\n";
+            break;
+          case '\r':
+            o << "\\r";
+            break;
+          case '\t':
+            o << "\\t";
+            break;
+          default:
+            if (static_cast<unsigned char> (c) < 0x20) {
+              char buf[8];
+              snprintf (buf, sizeof (buf), "\\u%04x", static_cast<unsigned char> (c));
+              o << buf;
+            }
+            else {
+              o << c;
+            }
+        }
+      }
+      o << '"';
+    }
+
+    JsonOut&
+    begin_object()
+    {
+      o_ << '{';
+      first_ = true;
+      return *this;
+    }
+
+    JsonOut&
+    end_object()
+    {
+      o_ << '}';
+      first_ = false;
+      return *this;
+    }
+
+    JsonOut&
+    begin_array (string const& key)
+    {
+      sep();
+      quote (o_, key);
+      o_ << ":[";
+      first_ = true;
+      return *this;
+    }
+
+    JsonOut&
+    end_array()
+    {
+      o_ << ']';
+      first_ = false;
+      return *this;
+    }
+
+    JsonOut&
+    element()
+    {
+      sep();
+      first_ = true;
+      return *this;
+    }
+
+    JsonOut&
+    raw (string const& key,
+         string const& json)
+    {
+      sep();
+      quote (o_, key);
+      o_ << ':' << json;
+      return *this;
+    }
+
+    JsonOut&
+    field (string const& key,
+           string const& value)
+    {
+      sep();
+      quote (o_, key);
+      o_ << ':';
+      quote (o_, value);
+      return *this;
+    }
+
+    template<typename T> JsonOut&
+    field (string const& key,
+           T const& value)
+    {
+      sep();
+      quote (o_, key);
+      o_ << ':' << value;
+      return *this;
+    }
+
+    JsonOut&
+    field (string const& key,
+           bool value)
+    {
+      sep();
+      quote (o_, key);
+      o_ << ':' << (value ? "true" : "false");
+      return *this;
+    }
+
+    JsonOut&
+    field (string const& key,
+           Time const& value)
+    {
+      return field (key, value.toSec());
+    }
+
+    JsonOut&
+    field (string const& key,
+           Duration const& value)
+    {
+      return field (key, value.toSec());
+    }
+
+    template<typename T> JsonOut&
+    value (T const& v)
+    {
+      sep();
+      o_ << v;
+      return *this;
+    }
+
+    JsonOut&
+    value (string const& v)
+    {
+      sep();
+      quote (o_, v);
+      return *this;
+    }
+
+    string
+    str() const
+    {
+      return o_.str();
+    }
+};
+
+
+
+string
+build_message (uint64_t seq,
+               string const& type,
+               map<string, SharedText> const& sections)
+{
+  JsonOut o;
+  o.begin_object();
+  o.field ("seq", seq);
+  o.field ("type", type);
+  JsonOut s;
+  s.begin_object();
+  for (auto const& i : sections) {
+    s.raw (i.first, *i.second);
+  }
+  s.end_object();
+  o.raw ("sections", s.str());
+  o.end_object();
+  return o.str();
+}
+
+
+
+class GatewayServer;
+
+class GatewayClient
+  : public boost::enable_shared_from_this<GatewayClient>
+  , boost::noncopyable
+{
+    GatewayServer& server_;
+    tcp::socket socket_;
+    boost::asio::streambuf request_;
+
+    deque<SharedText> queue_;
+    bool writing_;
+    bool needs_snapshot_;
+    bool streaming_;
+
+    void handle_request (boost::system::error_code const& ec);
+    void write_next();
+    void handle_write (boost::system::error_code const& ec);
+
+  public:
+    typedef boost::shared_ptr<GatewayClient> Ptr;
+
+    GatewayClient (GatewayServer& server,
+                   boost::asio::io_service& io,
+                   size_t max_request)
+      : server_ (server)
+      , socket_ (io)
+      , request_ (max_request)
+      , writing_ (false)
+      , needs_snapshot_ (false)
+      , streaming_ (false)
+    {
+    }
+
+    tcp::socket&
+    socket()
+    {
+      return socket_;
+    }
+
+    void
+    start()
+    {
+      boost::asio::async_read_until (socket_, request_, "\r\n\r\n",
+                                     boost::bind (&GatewayClient::handle_request, shared_from_this(),
+                                                  boost::asio::placeholders::error));
+    }
+
+    void push (SharedText const& text,
+               size_t max_queue);
+
+    void
+    close()
+    {
+      boost::system::error_code ec;
+      socket_.shutdown (tcp::socket::shutdown_both, ec);
+      socket_.close (ec);
+    }
+};
+
+
+
+class GatewayServer
+  : boost::noncopyable
+{
+    boost::asio::io_service& io_;
+    tcp::acceptor acceptor_;
+    size_t max_queue_;
+    size_t max_request_;
+
+    set<GatewayClient::Ptr> streams_;
+    map<string, SharedText> sections_;
+    uint64_t seq_;
+    // Built on demand, reset on every change
+    SharedText snapshot_;
+    SharedText snapshot_event_;
+
+    void
+    build_snapshot()
+    {
+      if (! snapshot_) {
+        string snapshot = build_message (seq_, "snapshot", sections_);
+        snapshot_event_ = std::make_shared<string> ("data: " + snapshot + "\n\n");
+        snapshot_ = std::make_shared<string> (std::move (snapshot));
+      }
+    }
+
+    void
+    accept()
+    {
+      GatewayClient::Ptr client (new GatewayClient (*this, io_, max_request_));
+      acceptor_.async_accept (client->socket(),
+                              boost::bind (&GatewayServer::handle_accept, this, client,
+                                           boost::asio::placeholders::error));
+    }
+
+    void
+    handle_accept (GatewayClient::Ptr client,
+                   boost::system::error_code const& ec)
+    {
+      if (! ec) {
+        client->start();
+      }
+      accept();
+    }
+
+  public:
+    GatewayServer (boost::asio::io_service& io,
+                   string const& address,
+                   unsigned short port,
+                   size_t max_queue,
+                   size_t max_request)
+      : io_ (io)
+      , acceptor_ (io, tcp::endpoint (boost::asio::ip::address::from_string (address), port))
+      , max_queue_ (max_queue)
+      , max_request_ (max_request)
+      , seq_ (0)
+    {
+      accept();
+    }
+
+    // Called in the io thread
+
+    void
+    publish (uint64_t seq,
+             map<string, SharedText> const& changed)
+    {
+      seq_ = seq;
+      for (auto const& i : changed) {
+        if (*i.second == "null") {
+          sections_.erase (i.first);
+        }
+        else {
+          sections_[i.first] = i.second;
+        }
+      }
+      snapshot_.reset();
+      snapshot_event_.reset();
+
+      if (streams_.empty()) {
+        return;
+      }
+      SharedText delta_event = std::make_shared<string> ("data: " + build_message (seq_, "delta", changed) + "\n\n");
+      for (GatewayClient::Ptr const& c : streams_) {
+        c->push (delta_event, max_queue_);
+      }
+    }
+
+    SharedText
+    snapshot()
+    {
+      build_snapshot();
+      return snapshot_;
+    }
+
+    SharedText
+    snapshot_event()
+    {
+      build_snapshot();
+      return snapshot_event_;
+    }
+
+    void
+    add_stream (GatewayClient::Ptr const& client)
+    {
+      streams_.insert (client);
+    }
+
+    void
+    remove_stream (GatewayClient::Ptr const& client)
+    {
+      streams_.erase (client);
+    }
+
+    size_t
+    stream_count() const
+    {
+      return streams_.size();
+    }
+};
+
+
+
+void
+GatewayClient::handle_request (boost::system::error_code const& ec)
+{
+  if (ec) {
+    // Also reached when the request does not fit in request_
+    close();
+    return;
+  }
+
+  istream is (&request_);
+  string method, path;
+  is >> method >> path;
+
+  if ( (method == "GET") && (path == "/events")) {
+    streaming_ = true;
+    queue_.push_back (std::make_shared<string> ("HTTP/1.1 200 OK\r\n"
+                                                "Content-Type: text/event-stream\r\n"
+                                                "Cache-Control: no-cache\r\n"
+                                                "Access-Control-Allow-Origin: *\r\n"
+                                                "Connection: keep-alive\r\n\r\n"));
+    queue_.push_back (server_.snapshot_event());
+    server_.add_stream (shared_from_this());
+  }
+  else if ( (method == "GET") && (path == "/state")) {
+    SharedText body = server_.snapshot();
+    ostringstream h;
+    h << "HTTP/1.1 200 OK\r\n"
+      << "Content-Type: application/json\r\n"
+      << "Access-Control-Allow-Origin: *\r\n"
+      << "Content-Length: " << body->size() << "\r\n"
+      << "Connection: close\r\n\r\n";
+    queue_.push_back (std::make_shared<string> (h.str()));
+    queue_.push_back (body);
+  }
+  else {
+    queue_.push_back (std::make_shared<string> ("HTTP/1.1 404 Not Found\r\n"
+                                                "Content-Length: 0\r\n"
+                                                "Connection: close\r\n\r\n"));
+  }
+
+  write_next();
+}
+
+void
+GatewayClient::push (SharedText const& text,
+                     size_t max_queue)
+{
+  if (needs_snapshot_) {
+    return;
+  }
+  if (queue_.size() >= max_queue) {
+    // Slow client: drop what is pending, resync with a snapshot. The
+    // front is kept while it is being written.
+    if (writing_) {
+      queue_.erase (queue_.begin() + 1, queue_.end());
+    }
+    else {
+      queue_.clear();
+    }
+    needs_snapshot_ = true;
+    if (! writing_) {
+      write_next();
+    }
+    return;
+  }
+  queue_.push_back (text);
+  if (! writing_) {
+    write_next();
+  }
+}
+
+void
+GatewayClient::write_next()
+{
+  if (queue_.empty() && needs_snapshot_) {
+    needs_snapshot_ = false;
+    queue_.push_back (server_.snapshot_event());
+  }
+  if (queue_.empty()) {
+    if (! streaming_) {
+      close();
+    }
+    return;
+  }
+
+  writing_ = true;
+  SharedText text = queue_.front();
+  boost::asio::async_write (socket_, boost::asio::buffer (*text),
+                            boost::bind (&GatewayClient::handle_write, shared_from_this(),
+                                         boost::asio::placeholders::error));
+}
+
+void
+GatewayClient::handle_write (boost::system::error_code const& ec)
+{
+  writing_ = false;
+  if (ec) {
+    server_.remove_stream (shared_from_this());
+    close();
+    return;
+  }
+  queue_.pop_front();
+  write_next();
+}
+
+
+
+class StateGateway
+  : boost::noncopyable
+{
+    NodeHandle nh_;
+    boost::asio::io_service io_;
+    boost::asio::io_service::work work_;
+    GatewayServer server_;
+    std::thread io_thread_;
+
+    Subscriber gui_sub_;
+    Subscriber public_sub_;
+
+    map<string, SharedText> sections_;
+    uint64_t seq_;
+
+    void
+    set_section (string const& name,
+                 string const& json,
+                 map<string, SharedText>& changed)
+    {
+      auto i = sections_.find (name);
+      if ( (i != sections_.end()) && (*i->second == json)) {
+        return;
+      }
+      SharedText text = std::make_shared<string> (json);
+      sections_[name] = text;
+      changed[name] = text;
+    }
+
+    void
+    remove_missing (string const& prefix,
+                    set<string> const& present,
+                    map<string, SharedText>& changed)
+    {
+      auto i = sections_.lower_bound (prefix);
+      while ( (i != sections_.end()) && (i->first.compare (0, prefix.size(), prefix) == 0)) {
+        if (present.count (i->first)) {
+          ++i;
+        }
+        else {
+          changed[i->first] = std::make_shared<string> ("null");
+          i = sections_.erase (i);
+        }
+      }
+    }
+
+    void
+    flush (map<string, SharedText> const& changed)
+    {
+      if (changed.empty()) {
+        return;
+      }
+      ++seq_;
+
+      // Only the changed sections are passed, the server builds the
+      // messages when they are needed
+      io_.post (boost::bind (&GatewayServer::publish, &server_, seq_, changed));
+    }
+
+    static string
+    zone_json (roah_rsbb::ZoneState const& z)
+    {
+      JsonOut o;
+      o.begin_object();
+      o.field ("zone", z.zone);
+      o.field ("name", z.name);
+      o.field ("desc", z.desc);
+      o.field ("code", z.code);
+      o.field ("timeout", z.timeout);
+      o.field ("team", z.team);
+      o.field ("round", static_cast<unsigned> (z.round));
+      o.field ("run", static_cast<unsigned> (z.run));
+      o.field ("schedule", z.schedule);
+      o.field ("timer", z.timer);
+      o.field ("state", z.state);
+      o.field ("manual_operation", z.manual_operation);
+      o.field ("connect_enabled", static_cast<bool> (z.connect_enabled));
+      o.field ("disconnect_enabled", static_cast<bool> (z.disconnect_enabled));
+      o.field ("start_enabled", static_cast<bool> (z.start_enabled));
+      o.field ("stop_enabled", static_cast<bool> (z.stop_enabled));
+      o.field ("prev_enabled", static_cast<bool> (z.prev_enabled));
+      o.field ("next_enabled", static_cast<bool> (z.next_enabled));
+      o.field ("omf", static_cast<bool> (z.omf));
+      o.begin_array ("omf_switches");
+      for (auto const& i : z.omf_switches) {
+        o.value (static_cast<unsigned> (i));
+      }
+      o.end_array();
+      o.field ("omf_damaged", static_cast<unsigned> (z.omf_damaged));
+      o.field ("omf_complete", static_cast<bool> (z.omf_complete));
+      o.begin_array ("scoring");
+      for (roah_rsbb::ZoneScoreGroup const& g : z.scoring) {
+        o.element().begin_object();
+        o.field ("group_name", g.group_name);
+        o.begin_array ("types");
+        for (auto const& i : g.types) {
+          o.value (static_cast<unsigned> (i));
+        }
+        o.end_array();
+        o.begin_array ("descriptions");
+        for (auto const& i : g.descriptions) {
+          o.value (i);
+        }
+        o.end_array();
+        o.begin_array ("current_values");
+        for (auto const& i : g.current_values) {
+          o.value (i);
+        }
+        o.end_array();
+        o.end_object();
+      }
+      o.end_array();
+      o.end_object();
+      return o.str();
+    }
+
+    static string
+    log_json (roah_rsbb::ZoneLog const& log)
+    {
+      JsonOut o;
+      o.begin_object();
+      o.begin_array ("topics");
+      for (auto const& i : log.topics) {
+        o.value (i);
+      }
+      o.end_array();
+      o.begin_array ("entries");
+      for (roah_rsbb::LogEntry const& e : log.entries) {
+        o.element().begin_object();
+        o.field ("seq", e.seq);
+        o.field ("stamp", e.stamp);
+        o.field ("topic", e.topic);
+        o.field ("type", static_cast<unsigned> (e.type));
+        o.field ("value", e.value);
+        o.field ("group", e.group);
+        o.field ("text", e.text);
+        o.end_object();
+      }
+      o.end_array();
+      o.end_object();
+      return o.str();
+    }
+
+    void
+    core_to_gui (roah_rsbb::CoreToGui::ConstPtr const& msg)
+    {
+      map<string, SharedText> changed;
+
+      {
+        JsonOut o;
+        o.begin_object();
+        o.field ("status", msg->status);
+        o.field ("addr", msg->addr);
+        o.field ("port", msg->port);
+        o.end_object();
+        set_section ("core", o.str(), changed);
+      }
+
+      {
+        JsonOut o;
+        o.begin_object();
+        o.field ("clock", msg->clock);
+        o.end_object();
+        set_section ("clock", o.str(), changed);
+      }
+
+      {
+        JsonOut o;
+        o.begin_object();
+        o.begin_array ("active_robots");
+        for (roah_rsbb::RobotInfo const& ri : msg->active_robots) {
+          o.element().begin_object();
+          o.field ("team", ri.team);
+          o.field ("robot", ri.robot);
+          o.field ("skew", ri.skew);
+          o.field ("skew_last", ri.skew_last);
+          o.field ("delay_median", ri.delay_median);
+          o.field ("delay_p95", ri.delay_p95);
+          o.field ("skew_samples", ri.skew_samples);
+          o.field ("beacon", ri.beacon);
+          o.end_object();
+        }
+        o.end_array();
+        o.end_object();
+        set_section ("robots", o.str(), changed);
+      }
+
+      {
+        JsonOut o;
+        o.begin_object();
+        o.field ("last_beacon", msg->tablet_last_beacon);
+        o.field ("display_map", static_cast<bool> (msg->tablet_display_map));
+        o.field ("call_time", msg->tablet_call_time);
+        o.field ("position_time", msg->tablet_position_time);
+        o.field ("position_x", msg->tablet_position_x);
+        o.field ("position_y", msg->tablet_position_y);
+        o.end_object();
+        set_section ("tablet", o.str(), changed);
+      }
+
+      set<string> present;
+      for (roah_rsbb::ZoneState const& z : msg->zones) {
+        string prefix = "zone/" + z.zone;
+        present.insert (prefix);
+        present.insert (prefix + "/log");
+        present.insert (prefix + "/online_data");
+        set_section (prefix, zone_json (z), changed);
+        set_section (prefix + "/log", log_json (z.log), changed);
+        set_section (prefix + "/online_data", log_json (z.online_data), changed);
+      }
+      remove_missing ("zone/", present, changed);
+
+      flush (changed);
+    }
+
+    void
+    core_to_public (roah_rsbb::CoreToPublic::ConstPtr const& msg)
+    {
+      map<string, SharedText> changed;
+
+      {
+        JsonOut o;
+        o.begin_object();
+        o.field ("clock", msg->clock);
+        o.end_object();
+        set_section ("public_clock", o.str(), changed);
+      }
+
+      {
+        JsonOut o;
+        o.begin_object();
+        o.begin_array ("schedule");
+        for (roah_rsbb::ScheduleInfo const& i : msg->schedule) {
+          o.element().begin_object();
+          o.field ("time", i.time);
+          o.field ("team", i.team);
+          o.field ("benchmark", i.benchmark);
+          o.field ("round", static_cast<unsigned> (i.round));
+          o.field ("run", static_cast<unsigned> (i.run));
+          o.field ("running", static_cast<bool> (i.running));
+          o.end_object();
+        }
+        o.end_array();
+        o.end_object();
+        set_section ("schedule", o.str(), changed);
+      }
+
+      flush (changed);
+    }
+
+  public:
+    StateGateway()
+      : nh_()
+      , io_()
+      , work_ (io_)
+      , server_ (io_,
+                 param_direct<string> ("~address", "127.0.0.1"),
+                 param_direct<int> ("~port", 8080),
+                 param_direct<int> ("~max_queue", 16),
+                 param_direct<int> ("~max_request", 8192))
+      , io_thread_ (boost::bind (&boost::asio::io_service::run, &io_))
+      , gui_sub_ (nh_.subscribe ("/core/to_gui", 1, &StateGateway::core_to_gui, this))
+      , public_sub_ (nh_.subscribe ("/core/to_public", 1, &StateGateway::core_to_public, this))
+      , seq_ (0)
+    {
+    }
+
+    ~StateGateway()
+    {
+      gui_sub_.shutdown();
+      public_sub_.shutdown();
+      io_.stop();
+      io_thread_.join();
+    }
+};
+
+
+
+int
+main (int argc,
+      char* argv[])
+{
+  init (argc, argv, "roah_rsbb_gateway");
+
+  StateGateway gateway;
+
+  spin();
+
+  return 0;
+}
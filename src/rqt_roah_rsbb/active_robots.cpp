@@ -36,6 +36,7 @@ namespace rqt_roah_rsbb
   ActiveRobots::ActiveRobots()
     : rqt_gui_cpp::Plugin()
     , widget_ (0)
+    , model_ (0)
   {
     setObjectName ("ActiveRobots");
   }
@@ -49,12 +50,14 @@ namespace rqt_roah_rsbb
     // extend the widget with all attributes and children from UI file
     ui_.setupUi (widget_);
 
+    model_ = new TextTableModel (QStringList() << "Team" << "Robot" << "Clock Skew" << "Delay (median / 95%)" << "Last Beacon", widget_);
+    ui_.table->setModel (model_);
     ui_.table->horizontalHeader()->setResizeMode (QHeaderView::Stretch);
 
     // add widget to the user interface
     context.addWidget (widget_);
 
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
+    core_rcv_.start ("/core/summary", getNodeHandle());
 
     connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
     update_timer_.start (100);
@@ -73,32 +76,43 @@ namespace rqt_roah_rsbb
     auto core_status = core_rcv_.last ();
 
     if (! core_status) {
-      ui_.table->setRowCount (0);
+      rows_.clear();
+      model_->set_rows (rows_);
       return;
     }
 
-    ui_.table->setRowCount (core_status->active_robots.size());
+    rows_.resize (core_status->active_robots.size());
 
     for (size_t r = 0; r < core_status->active_robots.size(); ++r) {
-      ui_.table->setItem (r, 0, new QTableWidgetItem (QString::fromStdString (core_status->active_robots.at (r).team)));
-      ui_.table->setItem (r, 1, new QTableWidgetItem (QString::fromStdString (core_status->active_robots.at (r).robot)));
+      roah_rsbb::RobotInfo const& ri = core_status->active_robots.at (r);
+      TextTableModel::Row& row = rows_[r];
+      row.cells.resize (5);
+      row.cells[0] = QString::fromStdString (ri.team);
+      row.cells[1] = QString::fromStdString (ri.robot);
 
-      auto skew = core_status->active_robots.at (r).skew.toSec();
+      auto skew = ri.skew.toSec();
       if ( (-0.1 < skew) && (skew < 0.1)) {
-        ui_.table->setItem (r, 2, new QTableWidgetItem ("OK"));
+        row.cells[2] = "OK";
       }
       else {
-        ui_.table->setItem (r, 2, new QTableWidgetItem (QString::number (skew, 'f', 1)));
+        row.cells[2] = QString::number (skew, 'f', 1);
       }
 
-      auto beacon = (core_status->active_robots.at (r).beacon - now).toSec();
+      row.cells[3] = QString ("%1 / %2 ms (%3)")
+                     .arg (ri.delay_median.toSec() * 1000, 0, 'f', 0)
+                     .arg (ri.delay_p95.toSec() * 1000, 0, 'f', 0)
+                     .arg (ri.skew_samples);
+
+      auto beacon = (ri.beacon - now).toSec();
       if ( (-3 < beacon) && (beacon < 0)) {
-        ui_.table->setItem (r, 3, new QTableWidgetItem ("OK"));
+        row.cells[4] = "OK";
       }
       else {
-        ui_.table->setItem (r, 3, new QTableWidgetItem (QString::number (beacon, 'f', 1)));
+        row.cells[4] = QString::number (beacon, 'f', 1);
       }
     }
+
+    model_->set_rows (rows_);
   }
 }
 
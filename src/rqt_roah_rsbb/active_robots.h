@@ -20,13 +20,16 @@
 #ifndef __RQT_ROAH_RSBB_ACTIVE_ROBOTS_H__
 #define __RQT_ROAH_RSBB_ACTIVE_ROBOTS_H__
 
+#include <vector>
+
 #include <QTimer>
 
 #include <ros/ros.h>
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_active_robots.h>
-#include <roah_rsbb/CoreToGui.h>
+#include <roah_rsbb/CoreSummary.h>
+#include "text_table_model.h"
 #include "topic_receiver.h"
 
 
@@ -47,7 +50,9 @@ namespace rqt_roah_rsbb
       Ui::ActiveRobots ui_;
       QWidget* widget_;
       QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      TopicReceiver<roah_rsbb::CoreSummary> core_rcv_;
+      TextTableModel* model_;
+      std::vector<TextTableModel::Row> rows_;
 
     private slots:
       void update();
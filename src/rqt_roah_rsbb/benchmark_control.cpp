@@ -45,6 +45,7 @@ namespace rqt_roah_rsbb
   BenchmarkControl::BenchmarkControl()
     : rqt_gui_cpp::Plugin()
     , widget_ (0)
+    , zone_rcv_ ("state")
   {
     setObjectName ("BenchmarkControl");
   }
@@ -67,7 +68,7 @@ namespace rqt_roah_rsbb
     connect (ui_.stop, SIGNAL (clicked()), this, SLOT (stop()));
     connect (ui_.previous, SIGNAL (clicked()), this, SLOT (previous()));
     connect (ui_.next, SIGNAL (clicked()), this, SLOT (next()));
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
+    core_rcv_.start ("/core/summary", getNodeHandle());
 
     connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
     update_timer_.start (200);
@@ -77,6 +78,7 @@ namespace rqt_roah_rsbb
   {
     update_timer_.stop();
     core_rcv_.stop();
+    zone_rcv_.stop();
   }
 
   void BenchmarkControl::update()
@@ -94,14 +96,11 @@ namespace rqt_roah_rsbb
 
     param_direct ("current_zone", string(), current_zone_);
 
-    roah_rsbb::ZoneState const* current_zone = nullptr;
+    set<string> new_zones (core_status->zones.begin(), core_status->zones.end());
 
-    set<string> new_zones;
-    for (roah_rsbb::ZoneState const& zone : core_status->zones) {
-      new_zones.insert (zone.zone);
-      if (zone.zone == current_zone_) {
-        current_zone = &zone;
-      }
+    auto current_zone = zone_rcv_.last (getNodeHandle());
+    if (! new_zones.count (current_zone_)) {
+      current_zone.reset();
     }
 
     if (known_zones_ != new_zones) {
@@ -116,7 +115,7 @@ namespace rqt_roah_rsbb
       QString current_index_text = ui_.zone->itemText (ui_.zone->currentIndex());
       QString new_zone = QString::fromStdString (current_zone_);
       if (current_index_text != new_zone) {
-        ui_.zone->setCurrentIndex (ui_.zone->findText (new_zone)); // Guaranteed to exist by for loop above
+        ui_.zone->setCurrentIndex (ui_.zone->findText (new_zone)); // Guaranteed to exist, checked above
       }
 
       ui_.name->setText (QString::fromStdString (current_zone->name));
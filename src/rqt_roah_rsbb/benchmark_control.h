@@ -28,8 +28,10 @@
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_benchmark_control.h>
-#include <roah_rsbb/CoreToGui.h>
+#include <roah_rsbb/CoreSummary.h>
+#include <roah_rsbb/ZoneState.h>
 #include "topic_receiver.h"
+#include "zone_receiver.h"
 
 
 
@@ -49,7 +51,8 @@ namespace rqt_roah_rsbb
       Ui::BenchmarkControl ui_;
       QWidget* widget_;
       QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      TopicReceiver<roah_rsbb::CoreSummary> core_rcv_;
+      ZoneReceiver<roah_rsbb::ZoneState> zone_rcv_;
 
       std::set<std::string> known_zones_;
       std::string current_zone_;
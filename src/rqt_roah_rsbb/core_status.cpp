@@ -56,7 +56,7 @@ namespace rqt_roah_rsbb
     // add widget to the user interface
     context.addWidget (widget_);
 
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
+    core_rcv_.start ("/core/summary", getNodeHandle());
 
     connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
     update_timer_.start (200);
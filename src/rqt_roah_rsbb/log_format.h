@@ -0,0 +1,64 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RQT_ROAH_RSBB_LOG_FORMAT_H__
+#define __RQT_ROAH_RSBB_LOG_FORMAT_H__
+
+#include <QDateTime>
+#include <QString>
+
+#include <roah_rsbb/ZoneLog.h>
+
+
+
+namespace rqt_roah_rsbb
+{
+  // Formats the entries of log whose topic contains filter, in local time
+  inline QString
+  format_log (roah_rsbb::ZoneLog const& log,
+              QString const& filter = QString())
+  {
+    QString text;
+    for (roah_rsbb::LogEntry const& e : log.entries) {
+      QString topic = e.topic < log.topics.size() ? QString::fromStdString (log.topics[e.topic]) : QString ("?");
+      if (! topic.contains (filter, Qt::CaseInsensitive)) {
+        continue;
+      }
+
+      text += "\n - ";
+      text += QDateTime::fromMSecsSinceEpoch (static_cast<qint64> (e.stamp.toNSec() / 1000000)).toString ("yyyy-MMM-dd hh:mm:ss.zzz");
+      text += " - ";
+      text += topic;
+      switch (e.type) {
+        case roah_rsbb::LogEntry::TYPE_UINT8:
+          text += "\n" + QString::number (e.value);
+          break;
+        case roah_rsbb::LogEntry::TYPE_STRING:
+          text += "\n" + QString::fromStdString (e.text);
+          break;
+        case roah_rsbb::LogEntry::TYPE_SCORE:
+          text += "\n" + QString::fromStdString (e.group) + ", " + QString::fromStdString (e.text) + " -> " + QString::number (e.value);
+          break;
+      }
+    }
+    return text;
+  }
+}
+
+#endif
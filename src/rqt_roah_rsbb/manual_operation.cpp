@@ -44,6 +44,7 @@ namespace rqt_roah_rsbb
   ManualOperation::ManualOperation()
     : rqt_gui_cpp::Plugin()
     , widget_ (0)
+    , zone_rcv_ ("state")
   {
     setObjectName ("ManualOperation");
   }
@@ -62,8 +63,6 @@ namespace rqt_roah_rsbb
     // add widget to the user interface
     context.addWidget (widget_);
 
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
-
     connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
     update_timer_.start (200);
 
@@ -76,24 +75,18 @@ namespace rqt_roah_rsbb
   void ManualOperation::shutdownPlugin()
   {
     update_timer_.stop();
-    core_rcv_.stop();
+    zone_rcv_.stop();
   }
 
   void ManualOperation::update()
   {
-    auto core = core_rcv_.last ();
-    string current_zone = param_direct ("current_zone", string());
-
-    if (core) {
-      for (roah_rsbb::ZoneState const& zone : core->zones) {
-        if ( (zone.zone == current_zone)
-             && (! zone.manual_operation.empty())) {
-          ui_.mo->setPalette (warn_palette_);
-          ui_.mo_complete->setEnabled (true);
-          ui_.mo->setPlainText (QString::fromStdString (zone.manual_operation));
-          return;
-        }
-      }
+    auto zone = zone_rcv_.last (getNodeHandle());
+
+    if (zone && (! zone->manual_operation.empty())) {
+      ui_.mo->setPalette (warn_palette_);
+      ui_.mo_complete->setEnabled (true);
+      ui_.mo->setPlainText (QString::fromStdString (zone->manual_operation));
+      return;
     }
 
     ui_.mo->setPalette (default_palette_);
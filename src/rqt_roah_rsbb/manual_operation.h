@@ -26,8 +26,8 @@
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_manual_operation.h>
-#include <roah_rsbb/CoreToGui.h>
-#include "topic_receiver.h"
+#include <roah_rsbb/ZoneState.h>
+#include "zone_receiver.h"
 
 
 
@@ -47,7 +47,7 @@ namespace rqt_roah_rsbb
       Ui::ManualOperation ui_;
       QWidget* widget_;
       QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      ZoneReceiver<roah_rsbb::ZoneState> zone_rcv_;
       QPalette default_palette_;
       QPalette warn_palette_;
 
@@ -60,6 +60,7 @@ namespace rqt_roah_rsbb
   OmfSwitches::OmfSwitches()
     : rqt_gui_cpp::Plugin()
     , widget_ (0)
+    , zone_rcv_ ("state")
     , CONTROL_DURATION (0.5)
     , last_control_ (TIME_MIN)
   {
@@ -113,8 +114,6 @@ namespace rqt_roah_rsbb
     // add widget to the user interface
     context.addWidget (widget_);
 
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
-
     connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
     update_timer_.start (200);
 
@@ -133,7 +132,7 @@ namespace rqt_roah_rsbb
   void OmfSwitches::shutdownPlugin()
   {
     update_timer_.stop();
-    core_rcv_.stop();
+    zone_rcv_.stop();
   }
 
   void OmfSwitches::disable()
@@ -168,57 +167,48 @@ namespace rqt_roah_rsbb
   {
     Time now = Time::now();
 
-    auto core = core_rcv_.last ();
-    string current_zone = param_direct ("current_zone", string());
-
-    if (core) {
-      for (roah_rsbb::ZoneState const& zone : core->zones) {
-        if (zone.zone == current_zone) {
-          if (! zone.omf) {
-            break;
-          }
-
-          if (! ui_.a->isEnabled()) {
-            ui_.a->setEnabled (true);
-            ui_.b->setEnabled (true);
-            ui_.c->setEnabled (true);
-            ui_.d->setEnabled (true);
-            ui_.e->setEnabled (true);
-            ui_.f->setEnabled (true);
-            ui_.g->setEnabled (true);
-            ui_.h->setEnabled (true);
-            ui_.i->setEnabled (true);
-            ui_.j->setEnabled (true);
-            ui_.damaged->setEnabled (true);
-          }
-
-          ui_.complete->setEnabled (zone.omf_complete);
-
-          if ( (now - last_control_) < CONTROL_DURATION) {
-            return;
-          }
-
-          ui_.a->setChecked (false);
-          ui_.b->setChecked (false);
-          ui_.c->setChecked (false);
-          ui_.d->setChecked (false);
-          ui_.e->setChecked (false);
-          ui_.f->setChecked (false);
-          ui_.g->setChecked (false);
-          ui_.h->setChecked (false);
-          ui_.i->setChecked (false);
-          ui_.j->setChecked (false);
-          for (auto const& i : zone.omf_switches) {
-            number_to_buttons_.at (i)->setChecked (true);
-          }
-
-          if (ui_.damaged->value() != static_cast<int> (zone.omf_damaged)) {
-            ui_.damaged->setValue (zone.omf_damaged);
-          }
-
-          return;
-        }
+    auto zone = zone_rcv_.last (getNodeHandle());
+
+    if (zone && zone->omf) {
+      if (! ui_.a->isEnabled()) {
+        ui_.a->setEnabled (true);
+        ui_.b->setEnabled (true);
+        ui_.c->setEnabled (true);
+        ui_.d->setEnabled (true);
+        ui_.e->setEnabled (true);
+        ui_.f->setEnabled (true);
+        ui_.g->setEnabled (true);
+        ui_.h->setEnabled (true);
+        ui_.i->setEnabled (true);
+        ui_.j->setEnabled (true);
+        ui_.damaged->setEnabled (true);
       }
+
+      ui_.complete->setEnabled (zone->omf_complete);
+
+      if ( (now - last_control_) < CONTROL_DURATION) {
+        return;
+      }
+
+      ui_.a->setChecked (false);
+      ui_.b->setChecked (false);
+      ui_.c->setChecked (false);
+      ui_.d->setChecked (false);
+      ui_.e->setChecked (false);
+      ui_.f->setChecked (false);
+      ui_.g->setChecked (false);
+      ui_.h->setChecked (false);
+      ui_.i->setChecked (false);
+      ui_.j->setChecked (false);
+      for (auto const& i : zone->omf_switches) {
+        number_to_buttons_.at (i)->setChecked (true);
+      }
+
+      if (ui_.damaged->value() != static_cast<int> (zone->omf_damaged)) {
+        ui_.damaged->setValue (zone->omf_damaged);
+      }
+
+      return;
     }
 
     disable();
@@ -28,8 +28,8 @@
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_omf_switches.h>
-#include <roah_rsbb/CoreToGui.h>
-#include "topic_receiver.h"
+#include <roah_rsbb/ZoneState.h>
+#include "zone_receiver.h"
 
 
 
@@ -49,7 +49,7 @@ namespace rqt_roah_rsbb
       Ui::OmfSwitches ui_;
       QWidget* widget_;
       QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      ZoneReceiver<roah_rsbb::ZoneState> zone_rcv_;
       const ros::Duration CONTROL_DURATION;
       ros::Time last_control_;
       std::map <int, QPushButton*> number_to_buttons_;
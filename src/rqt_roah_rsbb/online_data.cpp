@@ -33,6 +33,8 @@
 
 #include <std_srvs/Empty.h>
 
+#include "log_format.h"
+
 
 
 using namespace std;
@@ -45,6 +47,7 @@ namespace rqt_roah_rsbb
   OnlineData::OnlineData()
     : rqt_gui_cpp::Plugin()
     , widget_ (0)
+    , log_rcv_ ("online_data")
   {
     setObjectName ("OnlineData");
   }
@@ -61,8 +64,6 @@ namespace rqt_roah_rsbb
     // add widget to the user interface
     context.addWidget (widget_);
 
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
-
     connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
     update_timer_.start (200);
   }
@@ -70,26 +71,21 @@ namespace rqt_roah_rsbb
   void OnlineData::shutdownPlugin()
   {
     update_timer_.stop();
-    core_rcv_.stop();
+    log_rcv_.stop();
   }
 
   void OnlineData::update()
   {
-    auto core = core_rcv_.last ();
-    string current_zone = param_direct ("current_zone", string());
-
-    if (core) {
-      for (roah_rsbb::ZoneState const& zone : core->zones) {
-        if (zone.zone == current_zone) {
-          QString new_text = QString::fromStdString (zone.online_data);
-          if (ui_.display->toPlainText() != new_text) {
-            ui_.display->setPlainText (new_text);
-            QScrollBar* sb = ui_.display->verticalScrollBar();
-            sb->setValue (sb->maximum());
-          }
-          return;
-        }
+    auto log = log_rcv_.last (getNodeHandle());
+
+    if (log) {
+      QString new_text = format_log (*log);
+      if (ui_.display->toPlainText() != new_text) {
+        ui_.display->setPlainText (new_text);
+        QScrollBar* sb = ui_.display->verticalScrollBar();
+        sb->setValue (sb->maximum());
       }
+      return;
     }
 
     ui_.display->clear();
@@ -26,8 +26,8 @@
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_online_data.h>
-#include <roah_rsbb/CoreToGui.h>
-#include "topic_receiver.h"
+#include <roah_rsbb/ZoneLog.h>
+#include "zone_receiver.h"
 
 
 
@@ -47,7 +47,7 @@ namespace rqt_roah_rsbb
       Ui::OnlineData ui_;
       QWidget* widget_;
       QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      ZoneReceiver<roah_rsbb::ZoneLog> log_rcv_;
 
     private slots:
       void update();
@@ -37,11 +37,17 @@ PublicDisplay::PublicDisplay()
   : nh_()
   , screen_srv_ (nh_.advertiseService ("screen", &PublicDisplay::set_screen, this))
   , core_to_public_sub_ (nh_.subscribe ("/core/to_public", 1, &PublicDisplay::core_to_public, this))
+  , schedule_model_ (new rqt_roah_rsbb::TextTableModel (QStringList() << "Time" << "Team" << "Benchmark" << "Round" << "Run", this))
+  , layout_dirty_ (true)
+  , layout_width_ (0)
 {
   setObjectName ("PublicDisplay");
 
   ui_.setupUi (this);
 
+  schedule_model_->set_alignment (Qt::AlignCenter);
+  schedule_model_->set_highlight_color (QColor (247, 204, 6));
+  ui_.schedule->setModel (schedule_model_);
   ui_.schedule->horizontalHeader()->setResizeMode (QHeaderView::Fixed);
 
   connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
@@ -87,51 +93,56 @@ void PublicDisplay::core_to_public (roah_rsbb::CoreToPublic::ConstPtr const& msg
 {
   ui_.clock->setText (QString::fromStdString (msg->clock));
 
-  ui_.schedule->setRowCount (msg->schedule.size());
-
+  schedule_rows_.resize (msg->schedule.size());
   for (size_t r = 0; r < msg->schedule.size(); ++r) {
-    QTableWidgetItem* c0 = new QTableWidgetItem (QString::fromStdString (msg->schedule.at (r).time));
-    QTableWidgetItem* c1 = new QTableWidgetItem (QString::fromStdString (msg->schedule.at (r).team));
-    QTableWidgetItem* c2 = new QTableWidgetItem (QString::fromStdString (msg->schedule.at (r).benchmark));
-    QTableWidgetItem* c3 = new QTableWidgetItem (QString::number (msg->schedule.at (r).round));
-    QTableWidgetItem* c4 = new QTableWidgetItem (QString::number (msg->schedule.at (r).run));
-    if (msg->schedule.at (r).running) {
-      QColor selected (247, 204, 6);
-      c0->setTextColor (selected);
-      c1->setTextColor (selected);
-      c2->setTextColor (selected);
-      c3->setTextColor (selected);
-      c4->setTextColor (selected);
-    }
-    c0->setTextAlignment (Qt::AlignCenter);
-    c1->setTextAlignment (Qt::AlignCenter);
-    c2->setTextAlignment (Qt::AlignCenter);
-    c3->setTextAlignment (Qt::AlignCenter);
-    c4->setTextAlignment (Qt::AlignCenter);
-    ui_.schedule->setItem (r, 0, c0);
-    ui_.schedule->setItem (r, 1, c1);
-    ui_.schedule->setItem (r, 2, c2);
-    ui_.schedule->setItem (r, 3, c3);
-    ui_.schedule->setItem (r, 4, c4);
+    roah_rsbb::ScheduleInfo const& info = msg->schedule.at (r);
+    rqt_roah_rsbb::TextTableModel::Row& row = schedule_rows_[r];
+    row.cells.resize (5);
+    row.cells[0] = QString::fromStdString (info.time);
+    row.cells[1] = QString::fromStdString (info.team);
+    row.cells[2] = QString::fromStdString (info.benchmark);
+    row.cells[3] = QString::number (info.round);
+    row.cells[4] = QString::number (info.run);
+    row.highlight = info.running;
+  }
+
+  if (schedule_model_->set_rows (schedule_rows_)) {
+    layout_dirty_ = true;
   }
 }
 
 
 
-void PublicDisplay::update()
+void PublicDisplay::update_layout()
 {
-  spinOnce();
-  if (! ok()) {
-    QApplication::quit();
+  int width = ui_.schedule->horizontalHeader()->width();
+  if ( (! layout_dirty_) && (width == layout_width_)) {
+    return;
   }
+  layout_dirty_ = false;
+  layout_width_ = width;
 
-  int width = ui_.schedule->horizontalHeader()->width();
   ui_.schedule->horizontalHeader()->resizeSections (QHeaderView::ResizeToContents);
   int smallw = 0;
   for (int i = 0; i < 5; ++i) {
     smallw += ui_.schedule->columnWidth (i);
   }
+  if (smallw <= 0) {
+    return;
+  }
   for (int i = 0; i < 5; ++i) {
     ui_.schedule->setColumnWidth (i, width * ui_.schedule->columnWidth (i) / smallw);
   }
 }
+
+
+
+void PublicDisplay::update()
+{
+  spinOnce();
+  if (! ok()) {
+    QApplication::quit();
+  }
+
+  update_layout();
+}
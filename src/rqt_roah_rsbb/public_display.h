@@ -20,6 +20,8 @@
 #ifndef __RQT_ROAH_RSBB_PUBLIC_DISPLAY_H__
 #define __RQT_ROAH_RSBB_PUBLIC_DISPLAY_H__
 
+#include <vector>
+
 #include <QMainWindow>
 #include <QTimer>
 
@@ -28,6 +30,7 @@
 #include <ui_public_display.h>
 #include <roah_rsbb/UInt8.h>
 #include <roah_rsbb/CoreToPublic.h>
+#include "text_table_model.h"
 
 
 
@@ -46,6 +49,12 @@ class PublicDisplay
     QTimer update_timer_;
     ros::ServiceServer screen_srv_;
     ros::Subscriber core_to_public_sub_;
+    rqt_roah_rsbb::TextTableModel* schedule_model_;
+    std::vector<rqt_roah_rsbb::TextTableModel::Row> schedule_rows_;
+    bool layout_dirty_;
+    int layout_width_;
+
+    void update_layout();
 
     bool set_screen (roah_rsbb::UInt8::Request& req,
                      roah_rsbb::UInt8::Response& res);
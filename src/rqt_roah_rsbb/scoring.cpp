@@ -64,6 +64,7 @@ namespace rqt_roah_rsbb
   Scoring::Scoring()
     : rqt_gui_cpp::Plugin()
     , widget_ (0)
+    , zone_rcv_ ("state")
     , CONTROL_DURATION (1.0)
     , last_control_ (TIME_MIN)
   {
@@ -83,8 +84,6 @@ namespace rqt_roah_rsbb
     // add widget to the user interface
     context.addWidget (widget_);
 
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
-
     connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
     update_timer_.start (500);
   }
@@ -92,85 +91,79 @@ namespace rqt_roah_rsbb
   void Scoring::shutdownPlugin()
   {
     update_timer_.stop();
-    core_rcv_.stop();
+    zone_rcv_.stop();
   }
 
   void Scoring::update()
   {
     Time now = Time::now();
 
-    auto core_status = core_rcv_.last ();
-    if (! core_status) {
-      return;
-    }
+    auto zone = zone_rcv_.last (getNodeHandle());
 
     if ( (now - last_control_) < CONTROL_DURATION) {
       return;
     }
 
-    string current_zone = param_direct ("current_zone", string());
-    for (roah_rsbb::ZoneState const& zone : core_status->zones) {
-      if (zone.zone == current_zone) {
-        if (zone.scoring == last_scoring_) {
-          return;
-        }
+    if (zone) {
+      if (zone->scoring == last_scoring_) {
+        return;
+      }
 
-        QWidget().setLayout (ui_.layout);
-        ui_.setupUi (widget_);
-        service_template_.clear();
-
-        last_scoring_ = zone.scoring;
-
-        for (roah_rsbb::ZoneScoreGroup const& score_group : zone.scoring) {
-          auto gridGroupBox = new QGroupBox (QString::fromStdString (score_group.group_name));
-          QGridLayout* layout = new QGridLayout;
-
-          for (size_t i = 0 ; i < score_group.types.size() ; ++i) {
-            switch (score_group.types[i]) {
-              case roah_rsbb::ZoneScoreGroup::SCORING_BOOL: {
-                QCheckBox* checkbox = new QCheckBox();
-                checkbox->setCheckState (score_group.current_values.at (i) ? Qt::Checked : Qt::Unchecked);
-                checkbox->setSizePolicy (QSizePolicy::Maximum, QSizePolicy::Maximum);
-                QHBoxLayout* pLayout = new QHBoxLayout();
-                pLayout->addWidget (checkbox);
-                pLayout->setAlignment (Qt::AlignCenter);
-                pLayout->setContentsMargins (0, 0, 0, 0);
-                layout->addLayout (pLayout, i, 0);
-
-                connect (checkbox, SIGNAL (stateChanged (int)), this, SLOT (check_cb (int)));
-
-                roah_rsbb::ZoneScore tmp;
-                tmp.request.zone = current_zone;
-                tmp.request.score.group = score_group.group_name;
-                tmp.request.score.desc = score_group.descriptions.at (i);
-                service_template_[checkbox] = tmp;
-              }
-              break;
-              case roah_rsbb::ZoneScoreGroup::SCORING_UINT: {
-                auto spinbox = new QSpinBox();
-                spinbox->setValue (score_group.current_values.at (i));
-                layout->addWidget (spinbox, i, 0);
-
-                connect (spinbox, SIGNAL (valueChanged (int)), this, SLOT (spin_cb (int)));
-
-                roah_rsbb::ZoneScore tmp;
-                tmp.request.zone = current_zone;
-                tmp.request.score.group = score_group.group_name;
-                tmp.request.score.desc = score_group.descriptions.at (i);
-                service_template_[spinbox] = tmp;
-              }
-              break;
+      QWidget().setLayout (ui_.layout);
+      ui_.setupUi (widget_);
+      service_template_.clear();
+
+      last_scoring_ = zone->scoring;
+
+      for (roah_rsbb::ZoneScoreGroup const& score_group : zone->scoring) {
+        auto gridGroupBox = new QGroupBox (QString::fromStdString (score_group.group_name));
+        QGridLayout* layout = new QGridLayout;
+
+        for (size_t i = 0 ; i < score_group.types.size() ; ++i) {
+          switch (score_group.types[i]) {
+            case roah_rsbb::ZoneScoreGroup::SCORING_BOOL: {
+              QCheckBox* checkbox = new QCheckBox();
+              checkbox->setCheckState (score_group.current_values.at (i) ? Qt::Checked : Qt::Unchecked);
+              checkbox->setSizePolicy (QSizePolicy::Maximum, QSizePolicy::Maximum);
+              QHBoxLayout* pLayout = new QHBoxLayout();
+              pLayout->addWidget (checkbox);
+              pLayout->setAlignment (Qt::AlignCenter);
+              pLayout->setContentsMargins (0, 0, 0, 0);
+              layout->addLayout (pLayout, i, 0);
+
+              connect (checkbox, SIGNAL (stateChanged (int)), this, SLOT (check_cb (int)));
+
+              roah_rsbb::ZoneScore tmp;
+              tmp.request.zone = zone->zone;
+              tmp.request.score.group = score_group.group_name;
+              tmp.request.score.desc = score_group.descriptions.at (i);
+              service_template_[checkbox] = tmp;
             }
-            layout->addWidget (new QLabel (QString::fromStdString (score_group.descriptions.at (i))), i, 1);
+            break;
+            case roah_rsbb::ZoneScoreGroup::SCORING_UINT: {
+              auto spinbox = new QSpinBox();
+              spinbox->setValue (score_group.current_values.at (i));
+              layout->addWidget (spinbox, i, 0);
+
+              connect (spinbox, SIGNAL (valueChanged (int)), this, SLOT (spin_cb (int)));
+
+              roah_rsbb::ZoneScore tmp;
+              tmp.request.zone = zone->zone;
+              tmp.request.score.group = score_group.group_name;
+              tmp.request.score.desc = score_group.descriptions.at (i);
+              service_template_[spinbox] = tmp;
+            }
+            break;
           }
-
-          layout->setColumnStretch (1, 1);
-          gridGroupBox->setLayout (layout);
-          ui_.layout->addWidget (gridGroupBox);
+          layout->addWidget (new QLabel (QString::fromStdString (score_group.descriptions.at (i))), i, 1);
         }
 
-        return;
+        layout->setColumnStretch (1, 1);
+        gridGroupBox->setLayout (layout);
+        ui_.layout->addWidget (gridGroupBox);
       }
+
+      return;
     }
 
     QWidget().setLayout (ui_.layout);
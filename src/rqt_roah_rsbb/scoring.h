@@ -29,9 +29,9 @@
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_scoring.h>
-#include <roah_rsbb/CoreToGui.h>
+#include <roah_rsbb/ZoneState.h>
 #include <roah_rsbb/ZoneScore.h>
-#include "topic_receiver.h"
+#include "zone_receiver.h"
 
 
 
@@ -51,7 +51,7 @@ namespace rqt_roah_rsbb
       Ui::Scoring ui_;
       QScrollArea* widget_;
       QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      ZoneReceiver<roah_rsbb::ZoneState> zone_rcv_;
       const ros::Duration CONTROL_DURATION;
       ros::Time last_control_;
       std::vector<roah_rsbb::ZoneScoreGroup> last_scoring_;
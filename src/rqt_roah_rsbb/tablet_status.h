@@ -26,7 +26,7 @@
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_tablet_status.h>
-#include <roah_rsbb/CoreToGui.h>
+#include <roah_rsbb/CoreSummary.h>
 #include "topic_receiver.h"
 
 
@@ -47,7 +47,7 @@ namespace rqt_roah_rsbb
       Ui::TabletStatus ui_;
       QWidget* widget_;
       QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      TopicReceiver<roah_rsbb::CoreSummary> core_rcv_;
       const ros::Duration WARN_DURATION;
       ros::Time last_call_rcvd_;
       ros::Time last_call_time_;
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "text_table_model.h"
+
+
+
+using namespace std;
+
+
+
+namespace rqt_roah_rsbb
+{
+  TextTableModel::TextTableModel (QStringList const& headers,
+                                  QObject* parent)
+    : QAbstractTableModel (parent)
+    , headers_ (headers)
+  {
+  }
+
+  void TextTableModel::set_alignment (Qt::Alignment alignment)
+  {
+    alignment_ = QVariant (static_cast<int> (alignment));
+  }
+
+  void TextTableModel::set_highlight_color (QColor const& color)
+  {
+    highlight_color_ = QVariant (color);
+  }
+
+  bool TextTableModel::set_rows (vector<Row> const& rows)
+  {
+    bool changed = false;
+    const int columns = headers_.size();
+    const int old_size = rows_.size();
+    const int new_size = rows.size();
+
+    if (new_size < old_size) {
+      beginRemoveRows (QModelIndex(), new_size, old_size - 1);
+      rows_.resize (new_size);
+      endRemoveRows();
+      changed = true;
+    }
+
+    const int common = min (old_size, new_size);
+    for (int r = 0; r < common; ++r) {
+      Row& current = rows_[r];
+      Row const& next = rows[r];
+
+      if (current.highlight != next.highlight) {
+        current = next;
+        emit dataChanged (index (r, 0), index (r, columns - 1));
+        changed = true;
+        continue;
+      }
+
+      int first = -1, last = -1;
+      for (int c = 0; c < columns; ++c) {
+        if (current.cells.value (c) != next.cells.value (c)) {
+          if (first < 0) {
+            first = c;
+          }
+          last = c;
+        }
+      }
+      if (first >= 0) {
+        current.cells = next.cells;
+        emit dataChanged (index (r, first), index (r, last));
+        changed = true;
+      }
+    }
+
+    if (new_size > old_size) {
+      beginInsertRows (QModelIndex(), old_size, new_size - 1);
+      rows_.insert (rows_.end(), rows.begin() + old_size, rows.end());
+      endInsertRows();
+      changed = true;
+    }
+
+    return changed;
+  }
+
+  int TextTableModel::rowCount (QModelIndex const& parent) const
+  {
+    return parent.isValid() ? 0 : rows_.size();
+  }
+
+  int TextTableModel::columnCount (QModelIndex const& parent) const
+  {
+    return parent.isValid() ? 0 : headers_.size();
+  }
+
+  QVariant TextTableModel::data (QModelIndex const& index,
+                                 int role) const
+  {
+    if ( (! index.isValid())
+         || (index.row() >= static_cast<int> (rows_.size()))) {
+      return QVariant();
+    }
+
+    Row const& row = rows_[index.row()];
+    switch (role) {
+      case Qt::DisplayRole:
+        return row.cells.value (index.column());
+      case Qt::TextAlignmentRole:
+        return alignment_;
+      case Qt::ForegroundRole:
+        return row.highlight ? highlight_color_ : QVariant();
+      default:
+        return QVariant();
+    }
+  }
+
+  QVariant TextTableModel::headerData (int section,
+                                       Qt::Orientation orientation,
+                                       int role) const
+  {
+    if ( (orientation == Qt::Horizontal)
+         && (role == Qt::DisplayRole)
+         && (section < headers_.size())) {
+      return headers_.at (section);
+    }
+    return QAbstractTableModel::headerData (section, orientation, role);
+  }
+}
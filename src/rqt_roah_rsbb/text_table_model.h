@@ -0,0 +1,81 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RQT_ROAH_RSBB_TEXT_TABLE_MODEL_H__
+#define __RQT_ROAH_RSBB_TEXT_TABLE_MODEL_H__
+
+#include <vector>
+
+#include <QAbstractTableModel>
+#include <QColor>
+#include <QStringList>
+#include <QVector>
+
+
+
+namespace rqt_roah_rsbb
+{
+  /*
+   * Read only table of strings that keeps its rows across updates.
+   * set_rows() diffs the new rows against the current ones and only
+   * emits dataChanged for the cells that actually changed, so views
+   * do not have to recreate items on every message.
+   */
+  class TextTableModel
+    : public QAbstractTableModel
+  {
+      Q_OBJECT
+
+    public:
+      struct Row {
+        QVector<QString> cells;
+        bool highlight;
+
+        Row()
+          : highlight (false)
+        {
+        }
+      };
+
+      explicit TextTableModel (QStringList const& headers,
+                               QObject* parent = 0);
+
+      void set_alignment (Qt::Alignment alignment);
+      void set_highlight_color (QColor const& color);
+
+      // Returns true if any cell text changed or rows were added/removed
+      bool set_rows (std::vector<Row> const& rows);
+
+      virtual int rowCount (QModelIndex const& parent = QModelIndex()) const;
+      virtual int columnCount (QModelIndex const& parent = QModelIndex()) const;
+      virtual QVariant data (QModelIndex const& index,
+                             int role = Qt::DisplayRole) const;
+      virtual QVariant headerData (int section,
+                                   Qt::Orientation orientation,
+                                   int role = Qt::DisplayRole) const;
+
+    private:
+      QStringList headers_;
+      std::vector<Row> rows_;
+      QVariant alignment_;
+      QVariant highlight_color_;
+  };
+}
+
+#endif
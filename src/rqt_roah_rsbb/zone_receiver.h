@@ -0,0 +1,87 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RQT_ROAH_RSBB_ZONE_RECEIVER_H__
+#define __RQT_ROAH_RSBB_ZONE_RECEIVER_H__
+
+#include <memory>
+#include <string>
+
+#include <ros/ros.h>
+
+#include <roah_utils.h>
+#include <ros_roah_rsbb.h>
+
+#include "topic_receiver.h"
+#include "../zone_topics.h"
+
+
+
+namespace rqt_roah_rsbb
+{
+  /*
+   * Receives one of the per zone topics of the zone in the current_zone
+   * parameter, so that only the zone on display is sent by the core.
+   */
+  template<typename T>
+  class ZoneReceiver
+  {
+      const std::string name_;
+      std::string zone_;
+      std::unique_ptr<TopicReceiver<T>> rcv_;
+
+    public:
+      ZoneReceiver (std::string const& name)
+        : name_ (name)
+      {
+      }
+
+      // Last message of the current zone, null if none
+      typename T::ConstPtr
+      last (ros::NodeHandle& nh)
+      {
+        std::string zone = param_direct ("current_zone", std::string());
+        if (zone != zone_) {
+          stop();
+          zone_ = zone;
+          if (! zone_.empty()) {
+            rcv_.reset (new TopicReceiver<T>());
+            rcv_->start (zone_topic (zone_, name_), nh);
+          }
+        }
+
+        if (! rcv_) {
+          return typename T::ConstPtr();
+        }
+        return rcv_->last();
+      }
+
+      void
+      stop()
+      {
+        if (rcv_) {
+          rcv_->stop();
+          rcv_.reset();
+        }
+        zone_.clear();
+      }
+  };
+}
+
+#endif
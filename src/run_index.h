@@ -0,0 +1,184 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RUN_INDEX_H__
+#define __RUN_INDEX_H__
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+
+
+/*
+ * Index of the runs in a log directory.
+ *
+ * The core appends one line to runs_index.yaml when a run starts and
+ * another when it ends. Each line is a YAML flow map inside a block
+ * sequence, so the whole file is a valid YAML document that can be read
+ * at any time. When a file appears more than once, the last entry wins.
+ *
+ * Each run also has a sidecar <run>.yaml with its latest entry.
+ */
+
+namespace run_index
+{
+  const char INDEX_FILE[] = "runs_index.yaml";
+
+  struct RunInfo {
+    std::string file;
+    std::string compact_file;
+    std::string benchmark;
+    std::string team;
+    unsigned round;
+    unsigned run;
+    std::string uuid;
+    double start_time;
+    double end_time;
+    std::string final_state;
+    uint64_t size;
+
+    RunInfo()
+      : round (0)
+      , run (0)
+      , start_time (0)
+      , end_time (0)
+      , size (0)
+    {
+    }
+
+    bool
+    finished() const
+    {
+      return end_time != 0;
+    }
+  };
+
+  inline void
+  emit (YAML::Emitter& out,
+        RunInfo const& i)
+  {
+    out.SetDoublePrecision (15);
+    out << YAML::Flow << YAML::BeginMap;
+    out << YAML::Key << "file" << YAML::Value << i.file;
+    out << YAML::Key << "compact_file" << YAML::Value << i.compact_file;
+    out << YAML::Key << "benchmark" << YAML::Value << i.benchmark;
+    out << YAML::Key << "team" << YAML::Value << i.team;
+    out << YAML::Key << "round" << YAML::Value << i.round;
+    out << YAML::Key << "run" << YAML::Value << i.run;
+    out << YAML::Key << "uuid" << YAML::Value << i.uuid;
+    out << YAML::Key << "start_time" << YAML::Value << i.start_time;
+    out << YAML::Key << "end_time" << YAML::Value << i.end_time;
+    out << YAML::Key << "final_state" << YAML::Value << i.final_state;
+    out << YAML::Key << "size" << YAML::Value << i.size;
+    out << YAML::EndMap;
+  }
+
+  inline RunInfo
+  parse (YAML::Node const& n)
+  {
+    RunInfo i;
+    i.file = n["file"].as<std::string>();
+    i.compact_file = n["compact_file"].as<std::string> ("");
+    i.benchmark = n["benchmark"].as<std::string> ("");
+    i.team = n["team"].as<std::string> ("");
+    i.round = n["round"].as<unsigned> (0);
+    i.run = n["run"].as<unsigned> (0);
+    i.uuid = n["uuid"].as<std::string> ("");
+    i.start_time = n["start_time"].as<double> (0);
+    i.end_time = n["end_time"].as<double> (0);
+    i.final_state = n["final_state"].as<std::string> ("");
+    i.size = n["size"].as<uint64_t> (0);
+    return i;
+  }
+
+  // Appends an entry to the index of log_dir
+  inline void
+  append (std::string const& log_dir,
+          RunInfo const& info)
+  {
+    YAML::Emitter out;
+    out << YAML::BeginSeq;
+    emit (out, info);
+    out << YAML::EndSeq;
+
+    std::string path = (boost::filesystem::path (log_dir) / INDEX_FILE).string();
+    std::ofstream f (path.c_str(), std::ios::out | std::ios::app);
+    f << out.c_str() << std::endl;
+    if (! f) {
+      throw std::runtime_error ("could not append to " + path);
+    }
+  }
+
+  inline void
+  write_sidecar (std::string const& path,
+                 RunInfo const& info)
+  {
+    YAML::Emitter out;
+    emit (out, info);
+
+    std::string tmp = path + ".tmp";
+    {
+      std::ofstream f (tmp.c_str());
+      f << out.c_str() << std::endl;
+      if (! f) {
+        throw std::runtime_error ("could not write " + tmp);
+      }
+    }
+    boost::filesystem::rename (tmp, path);
+  }
+
+  inline RunInfo
+  read_sidecar (std::string const& path)
+  {
+    return parse (YAML::LoadFile (path));
+  }
+
+  // Latest entry of each run in log_dir, in order of first appearance
+  inline std::vector<RunInfo>
+  load (std::string const& log_dir)
+  {
+    std::vector<RunInfo> runs;
+    std::string path = (boost::filesystem::path (log_dir) / INDEX_FILE).string();
+    if (! boost::filesystem::exists (path)) {
+      return runs;
+    }
+
+    std::map<std::string, size_t> by_file;
+    for (YAML::Node const& n : YAML::LoadFile (path)) {
+      RunInfo i = parse (n);
+      auto f = by_file.find (i.file);
+      if (f == by_file.end()) {
+        by_file[i.file] = runs.size();
+        runs.push_back (i);
+      }
+      else {
+        runs[f->second] = i;
+      }
+    }
+    return runs;
+  }
+}
+
+#endif
@@ -0,0 +1,706 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Aggregates the final scores of all runs in a log directory and prints
+ * ranking tables per benchmark.
+ *
+ * The runs are taken from the run index of the directory, preferring the
+ * compact log of each run when there is one. Directories without an index
+ * are scanned for .bag and .rlog files. Every file is processed by a pool
+ * of workers. Results are cached per file path, size and modification
+ * time, falling back to the content hash when those change, so running
+ * again after a few new runs only reads the new files.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/regex.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+
+#include <std_msgs/String.h>
+#include <std_msgs/UInt8.h>
+#include <roah_rsbb/Score.h>
+
+#include "compact_log.h"
+#include "run_index.h"
+
+
+
+using namespace std;
+using namespace ros;
+namespace fs = boost::filesystem;
+
+
+
+struct ScoreItem {
+  string group;
+  string desc;
+  int32_t value;
+};
+
+
+
+struct RunResult {
+  string hash;
+  string path;
+  uintmax_t size;
+  time_t mtime;
+  string file;
+  string benchmark;
+  string team;
+  unsigned round;
+  unsigned run;
+  string uuid;
+  vector<ScoreItem> scores;
+  double exec_time;
+  string bmbox_score;
+  bool complete;
+
+  RunResult()
+    : size (0)
+    , mtime (0)
+    , benchmark ("unknown")
+    , round (0)
+    , run (0)
+    , exec_time (0)
+    , complete (false)
+  {
+  }
+
+  int32_t
+  group_sum (string const& prefix) const
+  {
+    int32_t sum = 0;
+    for (ScoreItem const& i : scores) {
+      if (i.group.compare (0, prefix.size(), prefix) == 0) {
+        sum += i.value;
+      }
+    }
+    return sum;
+  }
+
+  int32_t
+  achievements() const
+  {
+    return group_sum ("Achievement");
+  }
+
+  int32_t
+  penalized() const
+  {
+    return group_sum ("Penalized");
+  }
+
+  int32_t
+  disqualifying() const
+  {
+    return group_sum ("Disqualifying");
+  }
+};
+
+
+
+// Builds a RunResult from the sequence of logged events
+class RunExtractor
+{
+    RunResult& r_;
+    bool running_;
+    uint64_t running_since_;
+    uint64_t last_time_;
+
+  public:
+    RunExtractor (RunResult& r)
+      : r_ (r)
+      , running_ (false)
+      , running_since_ (0)
+      , last_time_ (0)
+    {
+    }
+
+    void
+    score (string const& topic,
+           string const& group,
+           string const& desc,
+           int32_t value)
+    {
+      if (topic != "/rsbb_log/score") {
+        return;
+      }
+      for (ScoreItem& i : r_.scores) {
+        if ( (i.group == group) && (i.desc == desc)) {
+          i.value = value;
+          return;
+        }
+      }
+      ScoreItem i;
+      i.group = group;
+      i.desc = desc;
+      i.value = value;
+      r_.scores.push_back (i);
+    }
+
+    void
+    text (string const& topic,
+          uint64_t time,
+          string const& s)
+    {
+      last_time_ = max (last_time_, time);
+      if (topic == "/rsbb_log/benchmark") {
+        r_.benchmark = s;
+      }
+      else if (topic == "/rsbb_log/bmbox/score") {
+        r_.bmbox_score = s;
+      }
+      else if (topic == "/rsbb_log/rsbb_state_str") {
+        bool running = s != "BenchmarkState_State_STOP";
+        if (running && ! running_) {
+          running_since_ = time;
+        }
+        else if (running_ && ! running) {
+          r_.exec_time += (time - running_since_) * 1e-9;
+        }
+        running_ = running;
+      }
+    }
+
+    void
+    other (string const& topic,
+           uint64_t time)
+    {
+      last_time_ = max (last_time_, time);
+      if (topic == "/rsbb_log/end") {
+        r_.complete = true;
+      }
+    }
+
+    void
+    finish()
+    {
+      if (running_) {
+        r_.exec_time += (last_time_ - running_since_) * 1e-9;
+        running_ = false;
+      }
+    }
+};
+
+
+
+void
+read_bag (string const& path,
+          RunExtractor& ex)
+{
+  rosbag::Bag bag;
+  bag.open (path, rosbag::bagmode::Read);
+  rosbag::View view (bag);
+  for (rosbag::MessageInstance const& m : view) {
+    uint64_t time = m.getTime().toNSec();
+    if (std_msgs::String::ConstPtr msg = m.instantiate<std_msgs::String>()) {
+      ex.text (m.getTopic(), time, msg->data);
+    }
+    else if (roah_rsbb::Score::ConstPtr msg = m.instantiate<roah_rsbb::Score>()) {
+      ex.score (m.getTopic(), msg->group, msg->desc, msg->value);
+      ex.other (m.getTopic(), time);
+    }
+    else {
+      ex.other (m.getTopic(), time);
+    }
+  }
+  bag.close();
+}
+
+
+
+void
+read_rlog (string const& path,
+           RunExtractor& ex)
+{
+  compact_log::Reader reader;
+  reader.open (path);
+
+  // The last time of every topic, and whether the run ended, come from the
+  // index; only the events of the topics with results are read
+  for (compact_log::TopicIndex const& ti : reader.topics()) {
+    if (ti.count > 0) {
+      ex.other (ti.name, ti.last_time);
+    }
+  }
+
+  vector<uint32_t> wanted;
+  for (char const* topic : {"/rsbb_log/benchmark", "/rsbb_log/bmbox/score", "/rsbb_log/rsbb_state_str", "/rsbb_log/score"}) {
+    int64_t id = reader.topic_id (topic);
+    if (id >= 0) {
+      wanted.push_back (id);
+    }
+  }
+  if (wanted.empty()) {
+    return;
+  }
+
+  reader.for_each ([&] (compact_log::Event const & e) {
+    string const& topic = reader.topic_name (e.topic);
+    switch (e.type) {
+      case compact_log::TAG_STRING:
+        ex.text (topic, e.time, e.text);
+        break;
+      case compact_log::TAG_SCORE:
+        ex.score (topic, e.group, e.text, e.value);
+        break;
+      default:
+        break;
+    }
+  }, 0, wanted);
+}
+
+
+
+string
+file_hash (string const& path)
+{
+  // FNV-1a, 64 bit
+  uint64_t h = 14695981039346656037ULL;
+  FILE* f = fopen (path.c_str(), "rb");
+  if (! f) {
+    throw runtime_error ("could not open " + path);
+  }
+  unsigned char buf[1 << 16];
+  size_t n;
+  while ( (n = fread (buf, 1, sizeof (buf), f)) > 0) {
+    for (size_t i = 0; i < n; ++i) {
+      h ^= buf[i];
+      h *= 1099511628211ULL;
+    }
+  }
+  fclose (f);
+
+  ostringstream o;
+  o << hex << setw (16) << setfill ('0') << h;
+  return o.str();
+}
+
+
+
+bool
+parse_name (string const& name,
+            RunResult& r)
+{
+  static const boost::regex re ("online_log_[^_]*_(.+)_round([0-9]+)_run([0-9]+)_([0-9a-f-]+)\\.(bag|rlog)");
+  boost::smatch m;
+  if (! boost::regex_match (name, m, re)) {
+    return false;
+  }
+  r.team = m[1];
+  r.round = stoul (m[2]);
+  r.run = stoul (m[3]);
+  r.uuid = m[4];
+  return true;
+}
+
+
+
+RunResult
+process (fs::path const& path,
+         string const& hash)
+{
+  RunResult r;
+  r.hash = hash;
+  r.file = path.filename().string();
+  parse_name (r.file, r);
+
+  RunExtractor ex (r);
+  if (path.extension() == ".rlog") {
+    read_rlog (path.string(), ex);
+  }
+  else {
+    read_bag (path.string(), ex);
+  }
+  ex.finish();
+
+  return r;
+}
+
+
+
+struct ScoreCache {
+  map<string, RunResult> by_hash;
+  map<string, RunResult> by_path;
+};
+
+
+
+ScoreCache
+load_cache (string const& path)
+{
+  ScoreCache cache;
+  if (! fs::exists (path)) {
+    return cache;
+  }
+
+  try {
+    YAML::Node file = YAML::LoadFile (path);
+    for (YAML::Node const& n : file) {
+      RunResult r;
+      r.hash = n["hash"].as<string>();
+      if (n["path"]) {
+        r.path = n["path"].as<string>();
+        r.size = n["size"].as<uintmax_t>();
+        r.mtime = n["mtime"].as<int64_t>();
+      }
+      r.file = n["file"].as<string>();
+      r.benchmark = n["benchmark"].as<string>();
+      r.team = n["team"].as<string>();
+      r.round = n["round"].as<unsigned>();
+      r.run = n["run"].as<unsigned>();
+      r.uuid = n["uuid"].as<string>();
+      r.exec_time = n["exec_time"].as<double>();
+      r.bmbox_score = n["bmbox_score"].as<string>();
+      r.complete = n["complete"].as<bool>();
+      for (YAML::Node const& s : n["scores"]) {
+        ScoreItem i;
+        i.group = s["group"].as<string>();
+        i.desc = s["desc"].as<string>();
+        i.value = s["value"].as<int32_t>();
+        r.scores.push_back (i);
+      }
+      cache.by_hash[r.hash] = r;
+      if (! r.path.empty()) {
+        cache.by_path[r.path] = r;
+      }
+    }
+  }
+  catch (std::exception const& e) {
+    cerr << "Ignoring unreadable cache " << path << ": " << e.what() << endl;
+    cache = ScoreCache();
+  }
+
+  return cache;
+}
+
+
+
+void
+save_cache (string const& path,
+            vector<RunResult> const& results)
+{
+  YAML::Emitter out;
+  out << YAML::BeginSeq;
+  for (RunResult const& r : results) {
+    out << YAML::BeginMap;
+    out << YAML::Key << "hash" << YAML::Value << r.hash;
+    out << YAML::Key << "path" << YAML::Value << r.path;
+    out << YAML::Key << "size" << YAML::Value << r.size;
+    out << YAML::Key << "mtime" << YAML::Value << static_cast<int64_t> (r.mtime);
+    out << YAML::Key << "file" << YAML::Value << r.file;
+    out << YAML::Key << "benchmark" << YAML::Value << r.benchmark;
+    out << YAML::Key << "team" << YAML::Value << r.team;
+    out << YAML::Key << "round" << YAML::Value << r.round;
+    out << YAML::Key << "run" << YAML::Value << r.run;
+    out << YAML::Key << "uuid" << YAML::Value << r.uuid;
+    out << YAML::Key << "exec_time" << YAML::Value << r.exec_time;
+    out << YAML::Key << "bmbox_score" << YAML::Value << r.bmbox_score;
+    out << YAML::Key << "complete" << YAML::Value << r.complete;
+    out << YAML::Key << "scores" << YAML::Value << YAML::BeginSeq;
+    for (ScoreItem const& i : r.scores) {
+      out << YAML::Flow << YAML::BeginMap;
+      out << YAML::Key << "group" << YAML::Value << i.group;
+      out << YAML::Key << "desc" << YAML::Value << i.desc;
+      out << YAML::Key << "value" << YAML::Value << i.value;
+      out << YAML::EndMap;
+    }
+    out << YAML::EndSeq;
+    out << YAML::EndMap;
+  }
+  out << YAML::EndSeq;
+
+  string tmp = path + ".tmp";
+  {
+    ofstream f (tmp.c_str());
+    f << out.c_str() << endl;
+  }
+  fs::rename (tmp, path);
+}
+
+
+
+// Ranking order: fewer disqualifying behaviours, more achievements,
+// fewer penalized behaviours, shorter execution time.
+bool
+better (RunResult const& a,
+        RunResult const& b)
+{
+  if (a.disqualifying() != b.disqualifying()) {
+    return a.disqualifying() < b.disqualifying();
+  }
+  if (a.achievements() != b.achievements()) {
+    return a.achievements() > b.achievements();
+  }
+  if (a.penalized() != b.penalized()) {
+    return a.penalized() < b.penalized();
+  }
+  return a.exec_time < b.exec_time;
+}
+
+
+
+void
+print_tables (vector<RunResult> const& results,
+              bool print_runs)
+{
+  map<string, vector<RunResult const*>> by_benchmark;
+  for (RunResult const& r : results) {
+    by_benchmark[r.benchmark].push_back (&r);
+  }
+
+  for (auto const& b : by_benchmark) {
+    // Best run of each team
+    map<string, RunResult const*> best;
+    for (RunResult const* r : b.second) {
+      auto i = best.find (r->team);
+      if ( (i == best.end()) || better (*r, *i->second)) {
+        best[r->team] = r;
+      }
+    }
+    vector<RunResult const*> ranking;
+    for (auto const& i : best) {
+      ranking.push_back (i.second);
+    }
+    stable_sort (ranking.begin(), ranking.end(),
+    [] (RunResult const * a, RunResult const * b) {
+      return better (*a, *b);
+    });
+
+    cout << "== " << b.first << " ==" << endl;
+    cout << left << setw (5) << "Rank" << setw (24) << "Team" << right
+         << setw (6) << "Round" << setw (5) << "Run"
+         << setw (8) << "Achiev" << setw (8) << "Penal" << setw (8) << "Disq"
+         << setw (10) << "Exec [s]" << "  BmBox" << endl;
+    unsigned rank = 0;
+    for (RunResult const* r : ranking) {
+      string bmbox = r->bmbox_score;
+      replace (bmbox.begin(), bmbox.end(), '\n', ' ');
+      cout << left << setw (5) << ++rank << setw (24) << r->team << right
+           << setw (6) << r->round << setw (5) << r->run
+           << setw (8) << r->achievements() << setw (8) << r->penalized() << setw (8) << r->disqualifying()
+           << setw (10) << fixed << setprecision (1) << r->exec_time << "  " << bmbox << endl;
+    }
+
+    if (print_runs) {
+      vector<RunResult const*> runs = b.second;
+      sort (runs.begin(), runs.end(),
+      [] (RunResult const * a, RunResult const * b) {
+        if (a->team != b->team) {
+          return a->team < b->team;
+        }
+        if (a->round != b->round) {
+          return a->round < b->round;
+        }
+        return a->run < b->run;
+      });
+      for (RunResult const* r : runs) {
+        cout << "-- " << r->team << " round " << r->round << " run " << r->run
+             << (r->complete ? "" : " (incomplete log)") << ": " << r->file << endl;
+        for (ScoreItem const& i : r->scores) {
+          cout << "   " << i.group << ": " << i.desc << " -> " << i.value << endl;
+        }
+      }
+    }
+    cout << endl;
+  }
+}
+
+
+
+int
+main (int argc,
+      char* argv[])
+{
+  Time::init();
+
+  unsigned jobs = max (1u, thread::hardware_concurrency());
+  string cache_path;
+  string log_dir;
+  bool print_runs = false;
+
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    if ( (a == "-j") && (i + 1 < argc)) {
+      jobs = max (1, atoi (argv[++i]));
+    }
+    else if ( (a == "--cache") && (i + 1 < argc)) {
+      cache_path = argv[++i];
+    }
+    else if (a == "--runs") {
+      print_runs = true;
+    }
+    else if (log_dir.empty() && (a[0] != '-')) {
+      log_dir = a;
+    }
+    else {
+      log_dir.clear();
+      break;
+    }
+  }
+  if (log_dir.empty()) {
+    cerr << "Usage: " << argv[0] << " [-j jobs] [--cache file] [--runs] <log_dir>" << endl;
+    return 1;
+  }
+  if (cache_path.empty()) {
+    cache_path = (fs::path (log_dir) / ".score_cache.yaml").string();
+  }
+
+  vector<fs::path> files;
+  vector<run_index::RunInfo> index;
+  try {
+    index = run_index::load (log_dir);
+  }
+  catch (std::exception const& e) {
+    cerr << "Ignoring run index: " << e.what() << endl;
+  }
+
+  // A run logged in both formats is read once, from the compact log
+  map<string, fs::path> by_stem;
+  for (fs::directory_iterator i (log_dir); i != fs::directory_iterator(); ++i) {
+    if (fs::is_regular_file (i->status())
+        && ( (i->path().extension() == ".bag") || (i->path().extension() == ".rlog"))) {
+      fs::path& f = by_stem[i->path().stem().string()];
+      if (f.empty() || (i->path().extension() == ".rlog")) {
+        f = i->path();
+      }
+    }
+  }
+
+  // The index decides for the runs it lists, files written before it
+  // existed are taken from the directory
+  for (run_index::RunInfo const& i : index) {
+    by_stem.erase (fs::path (i.file).stem().string());
+    if (! i.compact_file.empty()) {
+      by_stem.erase (fs::path (i.compact_file).stem().string());
+    }
+    if (! i.finished()) {
+      cerr << "Skipping unfinished run " << i.file << endl;
+      continue;
+    }
+    fs::path compact = fs::path (log_dir) / i.compact_file;
+    if (! i.compact_file.empty() && fs::exists (compact)) {
+      files.push_back (compact);
+    }
+    else {
+      files.push_back (fs::path (log_dir) / i.file);
+    }
+  }
+  for (auto const& i : by_stem) {
+    files.push_back (i.second);
+  }
+
+  sort (files.begin(), files.end());
+
+  const ScoreCache cache = load_cache (cache_path);
+
+  vector<RunResult> results (files.size());
+  vector<char> ok (files.size(), false);
+  atomic<size_t> next (0);
+  atomic<size_t> cached (0);
+  mutex err_mutex;
+
+  auto worker = [&]() {
+    for (size_t i = next++; i < files.size(); i = next++) {
+      try {
+        string path = fs::absolute (files[i]).string();
+        uintmax_t size = fs::file_size (files[i]);
+        time_t mtime = fs::last_write_time (files[i]);
+
+        // Only hash the content when the file is new or was touched
+        auto p = cache.by_path.find (path);
+        if ( (p != cache.by_path.end())
+             && (p->second.size == size)
+             && (p->second.mtime == mtime)) {
+          results[i] = p->second;
+          ++cached;
+        }
+        else {
+          string hash = file_hash (files[i].string());
+          auto c = cache.by_hash.find (hash);
+          if (c != cache.by_hash.end()) {
+            results[i] = c->second;
+            ++cached;
+          }
+          else {
+            results[i] = process (files[i], hash);
+          }
+        }
+        results[i].path = path;
+        results[i].size = size;
+        results[i].mtime = mtime;
+        results[i].file = files[i].filename().string();
+        ok[i] = true;
+      }
+      catch (std::exception const& e) {
+        lock_guard<mutex> lock (err_mutex);
+        cerr << "Skipping " << files[i].string() << ": " << e.what() << endl;
+      }
+    }
+  };
+
+  vector<thread> workers;
+  for (unsigned i = 0; i < min<size_t> (jobs, files.size()); ++i) {
+    workers.push_back (thread (worker));
+  }
+  for (thread& t : workers) {
+    t.join();
+  }
+
+  vector<RunResult> good;
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (ok[i]) {
+      good.push_back (results[i]);
+    }
+  }
+
+  cerr << files.size() << " files, " << cached << " from cache, "
+       << (good.size() - cached) << " processed, "
+       << (files.size() - good.size()) << " failed" << endl;
+
+  try {
+    save_cache (cache_path, good);
+  }
+  catch (std::exception const& e) {
+    cerr << "Could not save cache " << cache_path << ": " << e.what() << endl;
+  }
+
+  print_tables (good, print_runs);
+
+  return 0;
+}
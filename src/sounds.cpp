@@ -17,13 +17,15 @@
  * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <cstdlib>
+#include <boost/algorithm/string/replace.hpp>
 
 #include <ros/ros.h>
 #include <std_msgs/Empty.h>
 
 #include <ros_roah_rsbb.h>
 
+#include "audio_engine.h"
+
 
 
 using namespace std;
@@ -31,16 +33,62 @@ using namespace ros;
 
 
 
+// Declared before the engine, which plays from them until destroyed
+audio::Clip bell_clip;
+audio::Clip timeout_clip;
+unique_ptr<audio::Engine> engine;
+
+
+
 void bell (std_msgs::Empty::ConstPtr const& /*msg*/)
 {
-  system (param_direct<string> ("~bell_ring_command", "mplayer bell.mp3").c_str());
+  engine->play (bell_clip);
 }
 
 
 
 void timeout (std_msgs::Empty::ConstPtr const& /*msg*/)
 {
-  system (param_direct<string> ("~timeout_ring_command", "mplayer timeout.mp3").c_str());
+  engine->play (timeout_clip);
+}
+
+
+
+audio::Clip
+load_clip (string const& file,
+           unsigned rate)
+{
+  string command = param_direct<string> ("~decode_command", "mpg123 -q -m -e s16 -r {rate} -s '{file}'");
+  boost::replace_all (command, "{rate}", to_string (rate));
+  boost::replace_all (command, "{file}", file);
+  return audio::decode (command);
+}
+
+// Reads the parameters once, the result is also called from the mixer
+// thread to reopen the output
+function<unique_ptr<audio::Sink>() >
+sink_factory (unsigned rate)
+{
+  string sink = param_direct<string> ("~audio_sink", "alsa");
+  if (sink == "alsa") {
+    string device = param_direct<string> ("~alsa_device", "default");
+    unsigned latency_us = param_direct<double> ("~audio_buffer", 0.02) * 1e6;
+    return [device, rate, latency_us]() {
+      return unique_ptr<audio::Sink> (new audio::AlsaSink (device, rate, latency_us));
+    };
+  }
+  if (sink == "wav") {
+    string file = param_direct<string> ("~audio_wav_file", "sounds.wav");
+    return [file, rate]() {
+      return unique_ptr<audio::Sink> (new audio::FileSink (file, rate));
+    };
+  }
+  if (sink == "null") {
+    return [rate]() {
+      return unique_ptr<audio::Sink> (new audio::FileSink ("", rate));
+    };
+  }
+  throw runtime_error ("Unknown audio_sink \"" + sink + "\", expected alsa, wav or null");
 }
 
 
@@ -50,9 +98,30 @@ int main (int argc, char** argv)
   init (argc, argv, "roah_rsbb_sounds");
   NodeHandle nh;
 
+  unsigned rate = param_direct<int> ("~audio_rate", 44100);
+  try {
+    bell_clip = load_clip (param_direct<string> ("~bell_file", "bell.mp3"), rate);
+    timeout_clip = load_clip (param_direct<string> ("~timeout_file", "timeout.mp3"), rate);
+    engine.reset (new audio::Engine (sink_factory (rate),
+                                     rate,
+                                     param_direct<double> ("~audio_period", 0.005) * rate,
+                                     param_direct<int> ("~audio_max_voices", 8),
+    [] (double latency) {
+      ROS_INFO_STREAM ("Sound started, trigger to output " << static_cast<int> (latency * 1000) << " ms");
+    },
+    [] (string const& error) {
+      ROS_ERROR_STREAM_THROTTLE (10, "Audio output failed, retrying: " << error);
+    }));
+  }
+  catch (std::exception const& e) {
+    ROS_FATAL_STREAM ("Cannot start audio: " << e.what());
+    return 1;
+  }
+
   Subscriber bell_sub = nh.subscribe ("/devices/bell", 1, bell);
   Subscriber timeout_sub = nh.subscribe ("/timeout", 1, timeout);
   spin();
 
+  engine.reset();
   return 0;
 }
@@ -0,0 +1,436 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UDP_BATCH_H__
+#define __UDP_BATCH_H__
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+
+/*
+ * Batched UDP transport for the RSBB channels.
+ *
+ * A Socket receives and sends up to batch datagrams per system call with
+ * recvmmsg and sendmmsg, into buffers allocated once. Outgoing datagrams
+ * are queued and sent together by flush(). A ReceiveLoop waits on many
+ * sockets with a single epoll, so all channels share one receive loop.
+ *
+ * Sockets can join multicast groups instead of relying on subnet
+ * broadcast, so that hosts only receive the traffic of groups they
+ * joined.
+ *
+ * Linux only. Errors while setting up throw std::runtime_error.
+ */
+
+namespace udp_batch
+{
+  inline void
+  check (int ret,
+         const char* what)
+  {
+    if (ret < 0) {
+      throw std::runtime_error (std::string (what) + ": " + strerror (errno));
+    }
+  }
+
+  inline sockaddr_in
+  address (std::string const& host,
+           uint16_t port)
+  {
+    sockaddr_in addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons (port);
+    if (host.empty()) {
+      addr.sin_addr.s_addr = htonl (INADDR_ANY);
+    }
+    else if (inet_pton (AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+      throw std::runtime_error ("Invalid IPv4 address: " + host);
+    }
+    return addr;
+  }
+
+  inline bool
+  is_multicast (std::string const& host)
+  {
+    in_addr addr;
+    return (inet_pton (AF_INET, host.c_str(), &addr) == 1) && IN_MULTICAST (ntohl (addr.s_addr));
+  }
+
+  // Joins group on the interface with address interface, or on the
+  // default one when empty
+  inline void
+  join_group (int fd,
+              std::string const& group,
+              std::string const& interface)
+  {
+    ip_mreq mreq;
+    mreq.imr_multiaddr = address (group, 0).sin_addr;
+    mreq.imr_interface = address (interface, 0).sin_addr;
+    check (setsockopt (fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof (mreq)), ("IP_ADD_MEMBERSHIP " + group).c_str());
+  }
+
+  // Sets how multicast datagrams sent by fd leave the host
+  inline void
+  set_multicast_output (int fd,
+                        int ttl,
+                        std::string const& interface,
+                        bool loop)
+  {
+    check (setsockopt (fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof (ttl)), "IP_MULTICAST_TTL");
+    in_addr addr = address (interface, 0).sin_addr;
+    check (setsockopt (fd, IPPROTO_IP, IP_MULTICAST_IF, &addr, sizeof (addr)), "IP_MULTICAST_IF");
+    unsigned char l = loop ? 1 : 0;
+    check (setsockopt (fd, IPPROTO_IP, IP_MULTICAST_LOOP, &l, sizeof (l)), "IP_MULTICAST_LOOP");
+  }
+
+
+
+  /*
+   * Membership of a multicast group, held by a socket of its own.
+   *
+   * On Linux, a socket bound to the wildcard address receives the
+   * datagrams of every group joined by any socket of the host
+   * (IP_MULTICAST_ALL, on by default). This lets sockets owned by other
+   * libraries receive a group without changing them.
+   */
+  class Membership
+  {
+      int fd_;
+
+    public:
+      Membership (std::string const& group,
+                  std::string const& interface)
+        : fd_ (socket (AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0))
+      {
+        check (fd_, "socket");
+        try {
+          join_group (fd_, group, interface);
+        }
+        catch (...) {
+          close (fd_);
+          throw;
+        }
+      }
+
+      Membership (Membership const&) = delete;
+      Membership& operator= (Membership const&) = delete;
+
+      ~Membership()
+      {
+        close (fd_);
+      }
+  };
+
+
+
+  class Socket
+  {
+    public:
+      typedef std::function<void (sockaddr_in const& from, const char* data, size_t size) > Handler;
+
+    private:
+      int fd_;
+      const size_t batch_;
+      const size_t max_size_;
+
+      std::vector<char> rx_buffers_;
+      std::vector<sockaddr_in> rx_addrs_;
+      std::vector<iovec> rx_iov_;
+      std::vector<mmsghdr> rx_msgs_;
+
+      std::vector<char> tx_buffers_;
+      std::vector<sockaddr_in> tx_addrs_;
+      std::vector<iovec> tx_iov_;
+      std::vector<mmsghdr> tx_msgs_;
+      size_t tx_queued_;
+
+      uint64_t rx_calls_;
+      uint64_t tx_calls_;
+      uint64_t tx_dropped_;
+
+      void
+      setup (std::vector<char>& buffers,
+             std::vector<sockaddr_in>& addrs,
+             std::vector<iovec>& iov,
+             std::vector<mmsghdr>& msgs)
+      {
+        buffers.resize (batch_ * max_size_);
+        addrs.resize (batch_);
+        iov.resize (batch_);
+        msgs.resize (batch_);
+        for (size_t i = 0; i < batch_; ++i) {
+          iov[i].iov_base = &buffers[i * max_size_];
+          iov[i].iov_len = max_size_;
+          memset (&msgs[i], 0, sizeof (mmsghdr));
+          msgs[i].msg_hdr.msg_name = &addrs[i];
+          msgs[i].msg_hdr.msg_namelen = sizeof (sockaddr_in);
+          msgs[i].msg_hdr.msg_iov = &iov[i];
+          msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+      }
+
+    public:
+      // Binds to port on all interfaces; port 0 picks a free one
+      Socket (uint16_t port,
+              size_t batch = 32,
+              size_t max_size = 2048)
+        : fd_ (-1)
+        , batch_ (batch)
+        , max_size_ (max_size)
+        , tx_queued_ (0)
+        , rx_calls_ (0)
+        , tx_calls_ (0)
+        , tx_dropped_ (0)
+      {
+        fd_ = socket (AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        check (fd_, "socket");
+        int one = 1;
+        check (setsockopt (fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one)), "SO_REUSEADDR");
+        check (setsockopt (fd_, SOL_SOCKET, SO_BROADCAST, &one, sizeof (one)), "SO_BROADCAST");
+        sockaddr_in addr = address ("", port);
+        if (bind (fd_, reinterpret_cast<sockaddr*> (&addr), sizeof (addr)) < 0) {
+          int e = errno;
+          close (fd_);
+          errno = e;
+          check (-1, "bind");
+        }
+
+        setup (rx_buffers_, rx_addrs_, rx_iov_, rx_msgs_);
+        setup (tx_buffers_, tx_addrs_, tx_iov_, tx_msgs_);
+      }
+
+      Socket (Socket const&) = delete;
+      Socket& operator= (Socket const&) = delete;
+
+      ~Socket()
+      {
+        if (fd_ >= 0) {
+          close (fd_);
+        }
+      }
+
+      int
+      fd() const
+      {
+        return fd_;
+      }
+
+      uint16_t
+      port() const
+      {
+        sockaddr_in addr;
+        socklen_t len = sizeof (addr);
+        check (getsockname (fd_, reinterpret_cast<sockaddr*> (&addr), &len), "getsockname");
+        return ntohs (addr.sin_port);
+      }
+
+      void
+      join (std::string const& group,
+            std::string const& interface = "")
+      {
+        join_group (fd_, group, interface);
+      }
+
+      void
+      set_multicast_output (int ttl,
+                            std::string const& interface = "",
+                            bool loop = true)
+      {
+        udp_batch::set_multicast_output (fd_, ttl, interface, loop);
+      }
+
+      void
+      set_buffer_sizes (int size)
+      {
+        check (setsockopt (fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof (size)), "SO_RCVBUF");
+        check (setsockopt (fd_, SOL_SOCKET, SO_SNDBUF, &size, sizeof (size)), "SO_SNDBUF");
+      }
+
+      // Receives everything pending, batch datagrams per call; returns
+      // the number of datagrams received
+      size_t
+      receive (Handler const& handler)
+      {
+        size_t total = 0;
+        for (;;) {
+          for (size_t i = 0; i < batch_; ++i) {
+            rx_msgs_[i].msg_hdr.msg_namelen = sizeof (sockaddr_in);
+          }
+          int n = recvmmsg (fd_, rx_msgs_.data(), batch_, MSG_DONTWAIT, nullptr);
+          ++rx_calls_;
+          if (n <= 0) {
+            if ( (n < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+              check (n, "recvmmsg");
+            }
+            return total;
+          }
+          for (int i = 0; i < n; ++i) {
+            handler (rx_addrs_[i], &rx_buffers_[i * max_size_], rx_msgs_[i].msg_len);
+          }
+          total += n;
+          if (static_cast<size_t> (n) < batch_) {
+            return total;
+          }
+        }
+      }
+
+      // Queues a datagram, flushing first when the batch is full
+      void
+      queue (sockaddr_in const& to,
+             const char* data,
+             size_t size)
+      {
+        if (size > max_size_) {
+          ++tx_dropped_;
+          return;
+        }
+        if (tx_queued_ == batch_) {
+          flush();
+        }
+        memcpy (&tx_buffers_[tx_queued_ * max_size_], data, size);
+        tx_addrs_[tx_queued_] = to;
+        tx_iov_[tx_queued_].iov_len = size;
+        ++tx_queued_;
+      }
+
+      // Sends the queued datagrams; those the kernel refuses are dropped,
+      // as UDP would
+      void
+      flush()
+      {
+        size_t sent = 0;
+        while (sent < tx_queued_) {
+          int n = sendmmsg (fd_, &tx_msgs_[sent], tx_queued_ - sent, 0);
+          ++tx_calls_;
+          if (n < 0) {
+            if (errno == EINTR) {
+              continue;
+            }
+            tx_dropped_ += tx_queued_ - sent;
+            break;
+          }
+          sent += n;
+        }
+        tx_queued_ = 0;
+      }
+
+      uint64_t
+      rx_calls() const
+      {
+        return rx_calls_;
+      }
+
+      uint64_t
+      tx_calls() const
+      {
+        return tx_calls_;
+      }
+
+      uint64_t
+      tx_dropped() const
+      {
+        return tx_dropped_;
+      }
+  };
+
+
+
+  // One epoll for many sockets
+  class ReceiveLoop
+  {
+      int epoll_fd_;
+      std::map<int, std::pair<Socket*, Socket::Handler>> sockets_;
+      std::vector<epoll_event> events_;
+
+    public:
+      ReceiveLoop()
+        : epoll_fd_ (epoll_create1 (EPOLL_CLOEXEC))
+      {
+        check (epoll_fd_, "epoll_create1");
+      }
+
+      ReceiveLoop (ReceiveLoop const&) = delete;
+      ReceiveLoop& operator= (ReceiveLoop const&) = delete;
+
+      ~ReceiveLoop()
+      {
+        close (epoll_fd_);
+      }
+
+      void
+      add (Socket& socket,
+           Socket::Handler const& handler)
+      {
+        epoll_event ev;
+        memset (&ev, 0, sizeof (ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = socket.fd();
+        check (epoll_ctl (epoll_fd_, EPOLL_CTL_ADD, socket.fd(), &ev), "epoll_ctl");
+        sockets_[socket.fd()] = std::make_pair (&socket, handler);
+        events_.resize (sockets_.size());
+      }
+
+      void
+      remove (Socket& socket)
+      {
+        epoll_ctl (epoll_fd_, EPOLL_CTL_DEL, socket.fd(), nullptr);
+        sockets_.erase (socket.fd());
+      }
+
+      // Waits up to timeout_ms for datagrams and dispatches all of them;
+      // returns the number of datagrams received
+      size_t
+      run_once (int timeout_ms)
+      {
+        if (sockets_.empty()) {
+          return 0;
+        }
+        int n = epoll_wait (epoll_fd_, events_.data(), events_.size(), timeout_ms);
+        if ( (n < 0) && (errno != EINTR)) {
+          check (n, "epoll_wait");
+        }
+        size_t total = 0;
+        for (int i = 0; i < n; ++i) {
+          auto s = sockets_.find (events_[i].data.fd);
+          if (s != sockets_.end()) {
+            total += s->second.first->receive (s->second.second);
+          }
+        }
+        return total;
+      }
+  };
+}
+
+#endif
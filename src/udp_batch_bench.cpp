@@ -0,0 +1,217 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Loopback throughput of one datagram per system call against the
+ * batched transport. A sender thread keeps at most a window of
+ * datagrams in flight, and both sides report packets per second and CPU
+ * time per packet.
+ *
+ * With a group, the batched run also goes through loopback multicast.
+ * The receiving socket does not join the group itself; a separate
+ * membership does, as the core does for the comm channels.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include <poll.h>
+#include <time.h>
+
+#include "udp_batch.h"
+
+
+
+using namespace std;
+
+
+
+const size_t WINDOW = 256;
+
+
+
+double
+thread_cpu_ns()
+{
+  timespec ts;
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+struct Result {
+  double seconds;
+  double tx_cpu_ns;
+  double rx_cpu_ns;
+  uint64_t received;
+  uint64_t calls;
+};
+
+void
+wait_window (atomic<uint64_t> const& received,
+             uint64_t sent)
+{
+  while (sent > received.load() + WINDOW) {
+    this_thread::yield();
+  }
+}
+
+
+
+Result
+run_single (unsigned n,
+            size_t size)
+{
+  udp_batch::Socket rx (0);
+  udp_batch::Socket tx (0);
+  rx.set_buffer_sizes (1 << 22);
+  sockaddr_in to = udp_batch::address ("127.0.0.1", rx.port());
+
+  atomic<uint64_t> received (0);
+  Result r;
+
+  auto start = chrono::steady_clock::now();
+  thread sender ([&]() {
+    vector<char> data (size, 'x');
+    double cpu = thread_cpu_ns();
+    for (uint64_t sent = 0; sent < n; ++sent) {
+      wait_window (received, sent);
+      sendto (tx.fd(), data.data(), size, 0, reinterpret_cast<sockaddr const*> (&to), sizeof (to));
+    }
+    r.tx_cpu_ns = thread_cpu_ns() - cpu;
+  });
+
+  vector<char> buffer (2048);
+  uint64_t rx_calls = 0;
+  double cpu = thread_cpu_ns();
+  auto deadline = chrono::steady_clock::now() + chrono::seconds (10);
+  while ( (received.load() < n) && (chrono::steady_clock::now() < deadline)) {
+    sockaddr_in from;
+    socklen_t len = sizeof (from);
+    ssize_t got = recvfrom (rx.fd(), buffer.data(), buffer.size(), 0, reinterpret_cast<sockaddr*> (&from), &len);
+    ++rx_calls;
+    if (got >= 0) {
+      ++received;
+    }
+    else {
+      pollfd p = { rx.fd(), POLLIN, 0 };
+      poll (&p, 1, 10);
+      ++rx_calls;
+    }
+  }
+  r.rx_cpu_ns = thread_cpu_ns() - cpu;
+  sender.join();
+  r.seconds = chrono::duration<double> (chrono::steady_clock::now() - start).count();
+  r.received = received.load();
+  r.calls = n + rx_calls;
+  return r;
+}
+
+Result
+run_batched (unsigned n,
+             size_t size,
+             size_t batch,
+             string const& group)
+{
+  udp_batch::Socket rx (0, batch);
+  udp_batch::Socket tx (0, batch);
+  rx.set_buffer_sizes (1 << 22);
+  sockaddr_in to = udp_batch::address (group.empty() ? "127.0.0.1" : group, rx.port());
+
+  unique_ptr<udp_batch::Membership> membership;
+  if (! group.empty()) {
+    membership.reset (new udp_batch::Membership (group, "127.0.0.1"));
+    tx.set_multicast_output (1, "127.0.0.1", true);
+  }
+
+  atomic<uint64_t> received (0);
+  Result r;
+
+  auto start = chrono::steady_clock::now();
+  thread sender ([&]() {
+    vector<char> data (size, 'x');
+    double cpu = thread_cpu_ns();
+    for (uint64_t sent = 0; sent < n; ++sent) {
+      if ( (sent % batch) == 0) {
+        tx.flush();
+        wait_window (received, sent);
+      }
+      tx.queue (to, data.data(), size);
+    }
+    tx.flush();
+    r.tx_cpu_ns = thread_cpu_ns() - cpu;
+  });
+
+  uint64_t waits = 0;
+  udp_batch::ReceiveLoop loop;
+  loop.add (rx, [&] (sockaddr_in const&, const char*, size_t) {
+    ++received;
+  });
+  double cpu = thread_cpu_ns();
+  auto deadline = chrono::steady_clock::now() + chrono::seconds (10);
+  while ( (received.load() < n) && (chrono::steady_clock::now() < deadline)) {
+    loop.run_once (10);
+    ++waits;
+  }
+  r.rx_cpu_ns = thread_cpu_ns() - cpu;
+  sender.join();
+  r.seconds = chrono::duration<double> (chrono::steady_clock::now() - start).count();
+  r.received = received.load();
+  r.calls = tx.tx_calls() + rx.rx_calls() + waits;
+  return r;
+}
+
+void
+report (string const& name,
+        Result const& r)
+{
+  cout << name << r.received / r.seconds << " pkt/s, "
+       << r.tx_cpu_ns / r.received << " ns CPU/pkt tx, "
+       << r.rx_cpu_ns / r.received << " ns CPU/pkt rx, "
+       << static_cast<double> (r.calls) / r.received << " syscalls/pkt"
+       << " (" << r.received << " received)" << endl;
+}
+
+
+
+int
+main (int argc,
+      char* argv[])
+{
+  unsigned n = argc > 1 ? atoi (argv[1]) : 200000;
+  size_t size = argc > 2 ? atoi (argv[2]) : 200;
+  size_t batch = argc > 3 ? atoi (argv[3]) : 32;
+  string group = argc > 4 ? argv[4] : "";
+
+  try {
+    report ("one per call: ", run_single (n, size));
+    report ("batched:      ", run_batched (n, size, batch, ""));
+    if (! group.empty()) {
+      report ("multicast:    ", run_batched (n, size, batch, group));
+    }
+  }
+  catch (std::exception const& e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ZONE_TOPICS_H__
+#define __ZONE_TOPICS_H__
+
+#include <cctype>
+#include <string>
+
+
+
+/*
+ * Per zone topics, shared by the core and the GUI:
+ *   /core/zones/<zone>/state        roah_rsbb/ZoneState, without the logs
+ *   /core/zones/<zone>/log          roah_rsbb/ZoneLog
+ *   /core/zones/<zone>/online_data  roah_rsbb/ZoneLog
+ * Characters not allowed in topic names are replaced by '_'.
+ */
+inline std::string
+zone_topic (std::string const& zone,
+            std::string const& name)
+{
+  std::string topic = "/core/zones/";
+  for (char c : zone) {
+    topic += (std::isalnum (static_cast<unsigned char> (c)) || (c == '_')) ? c : '_';
+  }
+  if (zone.empty() || std::isdigit (static_cast<unsigned char> (zone[0]))) {
+    topic.insert (12, "_");
+  }
+  return topic + "/" + name;
+}
+
+#endif